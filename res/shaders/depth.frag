@@ -0,0 +1,6 @@
+#version 430 core
+
+// Depth prepass: nothing but the depth is written
+void main()
+{
+}
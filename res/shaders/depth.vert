@@ -0,0 +1,13 @@
+#version 430 core
+
+// Depth prepass: only the position, transformed exactly like simple.vert so that the shading pass can test GL_EQUAL
+in layout(location = 0) vec3 position;
+
+uniform layout(location = 3) mat4 MVP;
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = MVP * vec4(position, 1.0);
+}
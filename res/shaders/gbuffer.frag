@@ -0,0 +1,17 @@
+#version 430 core
+
+// Thin G-buffer for the hybrid ray tracer, drawn with simple.vert. The depth buffer holds the depth, the ray tracer
+// rebuilds the world space hit point from it.
+in layout(location = 0) vec3 normal_in;
+
+// Index into the ray tracer's material buffer
+uniform uint materialID;
+
+// World space normal packed into [0, 1]
+out layout(location = 0) vec4 normalOut;
+out layout(location = 1) uint materialOut;
+
+void main() {
+    normalOut   = vec4(normalize(normal_in) * 0.5 + 0.5, 0.0);
+    materialOut = materialID;
+}
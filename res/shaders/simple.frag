@@ -1,7 +1,5 @@
 #version 430 core
 
-#define MAX_LIGHTS 64
-
 //
 // Scene constants
 //
@@ -27,32 +25,69 @@ const float ATTENUATION_CONST_QUADRATIC = 0.0038; // quadratic term
 //
 struct LightSource {
     vec3 position;
+    float radius;     // the light is too dim to see past this distance
     vec3 color;
+    float pad0;
+};
+
+// Shared with raytracer.comp, written into the frame ring every frame
+layout(std430, binding = 0) readonly buffer Lights {
+    int numLights;
+    LightSource lights[];
+};
+
+#ifdef CLUSTERED_LIGHTS
+// The lights that reach every cluster of the view frustum, written by cluster.comp
+layout(std430, binding = 5) readonly buffer ClusterRanges {
+    uvec2 clusterRanges[];    // offset and length in clusterLights, the length is CLUSTER_OVERFLOW if it didn't fit
+};
+
+layout(std430, binding = 6) readonly buffer ClusterLights {
+    uint clusterLights[];
 };
 
-uniform LightSource lights[MAX_LIGHTS];
-uniform int numLights;
+const uint CLUSTER_OVERFLOW = 0xFFFFFFFFu;
 
+uniform ivec3 clusterGrid;
+uniform vec2 clusterDepthRange;   // near and far plane
+uniform vec2 clusterScreenSize;
+#endif
 
 uniform vec3 cameraPosition;
 uniform vec3 ballCenter;
 
+// Deferred shading splits this shader in two: the DEFERRED_GBUFFER variant only writes the surface into the G-buffer,
+// and the DEFERRED_LIGHTING variant is drawn over the whole screen and shades what the G-buffer holds
+#ifdef DEFERRED_LIGHTING
+// Depth, octahedral normal, and albedo with the roughness in alpha
+uniform sampler2D gbufferDepth;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferAlbedo;
+uniform mat4 invViewProjection;
+#else
 in layout(location = 0) vec3 normal_in;
 in layout(location = 1) vec2 textureCoordinates;
 in layout(location = 2) vec3 fragPos_in;
 in layout(location = 3) mat3 TBN;
+#endif
 
-// Normal mapping stuff
-uniform bool useNormalMap;
+// Normal mapping stuff, only in the USE_NORMAL_MAP variant
+#ifdef USE_NORMAL_MAP
 uniform sampler2D diffuseMap;
 uniform sampler2D normalMap;
 uniform sampler2D roughnessMap;
+#endif
 
 
 //
 // Fragment output
 //
+#ifdef DEFERRED_GBUFFER
+out layout(location = 0) vec4 normalOut;
+out layout(location = 1) vec4 albedoOut;
+#else
 out vec4 color;
+#endif
 
 float rand(vec2 co) { return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453); }
 float dither(vec2 uv) { return (rand(uv)*2.0-1.0) / 256.0; }
@@ -98,27 +133,37 @@ float shadowFactor(vec3 fragPos, vec3 lightPos, vec3 ballCenter, float ballRadiu
     }
 }
 
-void main()
-{
-    // For safety, re-normalize the normal once more
-    vec3 surfaceNormal = normalize(normal_in);
-
-    // If using normal map, override the normal_in
-    if (useNormalMap) {
-        // Sample from the normal map
-        vec3 normalMapValue = texture(normalMap, textureCoordinates).rgb;
-
-        // Convert from [0,1] to [-1,1]
-        normalMapValue = normalMapValue * 2.0 - 1.0;
+#ifdef CLUSTERED_LIGHTS
+// The light list of the cluster that a fragment at window depth `depth` is in, same slicing as cluster.comp
+uvec2 clusterRange(float depth) {
+    float nearPlane = clusterDepthRange.x;
+    float farPlane = clusterDepthRange.y;
+    float ndcDepth = depth * 2.0 - 1.0;
+    float viewDepth = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - ndcDepth * (farPlane - nearPlane));
+
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterScreenSize * vec2(clusterGrid.xy));
+    int slice = int(log(viewDepth / nearPlane) / log(farPlane / nearPlane) * float(clusterGrid.z));
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), clusterGrid - 1);
+    return clusterRanges[cluster.x + clusterGrid.x * (cluster.y + clusterGrid.y * cluster.z)];
+}
+#endif
 
-        // Transform it by TBN
-        surfaceNormal = normalize(TBN * normalMapValue);
+// Everything the lighting needs to know about the surface, straight from the mesh in the forward path or from the
+// G-buffer in the deferred one
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    float shininessFactor;
+    vec3 albedo;      // multiplies the lit color, white without a diffuse map
+    float depth;      // window depth, to find the cluster
+};
 
-        // Debug: show the TBN-transformed normal
-        // vec3 debugNormal = 0.5 * (TBN * (texture(normalMap, textureCoordinates).xyz * 2.0 - 1.0) + 1.0);
-        // color = vec4(debugNormal, 1.0);
-        // return;
-    }
+// Lights the surface with every light that reaches it
+vec3 shadeSurface(Surface surface)
+{
+    vec3 fragPos = surface.position;
+    vec3 surfaceNormal = surface.normal;
+    float shininessFactor = surface.shininessFactor;
 
     // Start with the ambient color
     vec3 ambientContribution = AMBIENT_CONTRIBUTION;
@@ -127,26 +172,37 @@ void main()
     vec3 diffuseSum  = vec3(0.0);
     vec3 specularSum = vec3(0.0);
 
-    // Prepare the shininess factor
-    float shininessFactor = SHININESS_FACTOR_DEFAULT;
-    if (useNormalMap) {
-        float roughness = texture(roughnessMap, textureCoordinates).r;
-        shininessFactor = 5.0 / max(roughness * roughness, 1e-8); // Avoid division by zero by adding a small epsilon
-    }
-
     // The view (eye) direction: from fragment to camera
-    vec3 viewDirection = normalize(cameraPosition - fragPos_in);
-
-    // Loop over all lights
-    for (int i = 0; i < numLights; i++) {
+    vec3 viewDirection = normalize(cameraPosition - fragPos);
+
+    // Loop over the lights of this fragment's cluster, or over all lights
+#ifdef CLUSTERED_LIGHTS
+    uvec2 range = clusterRange(surface.depth);
+    bool overflow = range.y == CLUSTER_OVERFLOW;
+    int lightCount = overflow ? numLights : int(range.y);
+#else
+    int lightCount = numLights;
+#endif
+    for (int n = 0; n < lightCount; n++) {
+#ifdef CLUSTERED_LIGHTS
+        int i = overflow ? n : int(clusterLights[range.x + uint(n)]);
+#else
+        int i = n;
+#endif
         vec3 lightPosition = lights[i].position;
         vec3 lightColor = lights[i].color;
 
+        // Skip lights that are too far away to be seen
+        vec3 toLight = lightPosition - fragPos;
+        if (dot(toLight, toLight) > lights[i].radius * lights[i].radius) {
+            continue;
+        }
+
         // Compute the shadow factor (1 = fully shadowed, 0 = no shadow)
-        float shadow = shadowFactor(fragPos_in, lightPosition, ballCenter, BALL_RADIUS);
+        float shadow = shadowFactor(fragPos, lightPosition, ballCenter, BALL_RADIUS);
 
         // Vector from fragment to light
-        vec3  vectorToLight   = lightPosition - fragPos_in;
+        vec3  vectorToLight   = lightPosition - fragPos;
         float distanceToLight = length(vectorToLight);
         vec3  lightDirection  = normalize(vectorToLight);
 
@@ -166,18 +222,109 @@ void main()
         specularSum += (1.0 - shadow) * specularFactor * lightColor * attenuationFactor;
     }
 
-    // Add them all up + emission
-    vec3 finalColor = ambientContribution + diffuseSum + specularSum + EMISSION_COLOR;
+    // Add them all up + emission, times the diffuse map color
+    return (ambientContribution + diffuseSum + specularSum + EMISSION_COLOR) * surface.albedo;
+}
 
-    // If using normal map, multiply by the diffuse map color
-    if (useNormalMap) {
-        finalColor *= texture(diffuseMap, textureCoordinates).rgb;
+// Octahedral normal encoding: the unit sphere folded onto the [-1, 1] square, two values for a normal
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeOctahedral(vec3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    return normal.z >= 0.0 ? normal.xy : (1.0 - abs(normal.yx)) * signNotZero(normal.xy);
+}
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0.0) {
+        normal.xy = (1.0 - abs(normal.yx)) * signNotZero(normal.xy);
+    }
+    return normalize(normal);
+}
+
+// Shininess is stored as the roughness it comes from, see the normal mapped surface below
+float shininessToRoughness(float shininessFactor) {
+    return sqrt(5.0 / shininessFactor);
+}
+
+float roughnessToShininess(float roughness) {
+    return 5.0 / max(roughness * roughness, 1e-8); // Avoid division by zero by adding a small epsilon
+}
+
+#ifdef DEFERRED_LIGHTING
+// Shades the pixel the G-buffer saw, over the whole screen. Also writes the depth, so that occlusion culling sees the
+// same depth buffer as after the forward path.
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, pixel, 0).r;
+    if (depth >= 1.0) {
+        discard;
     }
+    vec4 material = texelFetch(gbufferAlbedo, pixel, 0);
+
+    Surface surface;
+    vec4 ndcPosition = vec4(gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0)) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPosition = invViewProjection * ndcPosition;
+    surface.position = worldPosition.xyz / worldPosition.w;
+    surface.normal = decodeOctahedral(texelFetch(gbufferNormal, pixel, 0).xy);
+    surface.shininessFactor = roughnessToShininess(material.a);
+    surface.albedo = material.rgb;
+    surface.depth = depth;
+
+    color = vec4(shadeSurface(surface), 1.0);
+    color.rgb += dither(gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0)));
+    gl_FragDepth = depth;
+}
+
+#else
+void main()
+{
+    Surface surface;
+    surface.position = fragPos_in;
+    surface.depth = gl_FragCoord.z;
+
+    // For safety, re-normalize the normal once more
+    surface.normal = normalize(normal_in);
+
+    // If using normal map, override the normal_in
+#ifdef USE_NORMAL_MAP
+    {
+        // Sample from the normal map
+        vec3 normalMapValue = texture(normalMap, textureCoordinates).rgb;
+
+        // Convert from [0,1] to [-1,1]
+        normalMapValue = normalMapValue * 2.0 - 1.0;
 
+        // Transform it by TBN
+        surface.normal = normalize(TBN * normalMapValue);
+    }
+#endif
+
+    // Prepare the shininess factor, and the diffuse map color that multiplies the lit color
+#ifdef USE_NORMAL_MAP
+    float roughness = texture(roughnessMap, textureCoordinates).r;
+    surface.shininessFactor = roughnessToShininess(roughness);
+    surface.albedo = texture(diffuseMap, textureCoordinates).rgb;
+#else
+    float roughness = shininessToRoughness(SHININESS_FACTOR_DEFAULT);
+    surface.shininessFactor = SHININESS_FACTOR_DEFAULT;
+    surface.albedo = vec3(1.0);
+#endif
+
+#ifdef DEFERRED_GBUFFER
+    // Only store the surface, the lighting pass shades it
+    normalOut = vec4(encodeOctahedral(surface.normal), 0.0, 0.0);
+    albedoOut = vec4(surface.albedo, roughness);
+#else
     // Output final color
-    color = vec4(finalColor, 1.0);
+    color = vec4(shadeSurface(surface), 1.0);
 
     // Add some dithering noise
     float noise = dither(textureCoordinates);
     color.rgb += noise;
-}
\ No newline at end of file
+#endif
+}
+#endif
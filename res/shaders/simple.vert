@@ -19,6 +19,9 @@ out layout(location = 1) vec2 textureCoordinates_out;
 out layout(location = 2) vec3 fragPos_out;
 out layout(location = 3) mat3 TBN;
 
+// Must match the depth prepass in depth.vert to the bit
+invariant gl_Position;
+
 
 void main()
 {
@@ -0,0 +1,21 @@
+#version 430 core
+
+in vec2 texCoord;
+out vec4 FragColor;
+
+// The ray traced image only covers the bottom left `traceScale` part of the texture
+uniform sampler2D tracedImage;
+uniform vec2 traceScale;
+
+// Same dither as simple.frag, so that both paths band the same way after quantizing to 8 bits
+float rand(vec2 co) { return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453); }
+float dither(vec2 uv) { return (rand(uv)*2.0-1.0) / 256.0; }
+
+void main() {
+    // Bilinear upscale, clamped half a texel inside the traced region so that no stale texels bleed in
+    vec2 halfTexel = 0.5 / vec2(textureSize(tracedImage, 0));
+    vec2 uv = min(texCoord * traceScale, traceScale - halfTexel);
+    vec3 color = texture(tracedImage, uv).rgb;
+
+    FragColor = vec4(color + dither(texCoord), 1.0);
+}
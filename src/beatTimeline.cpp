@@ -0,0 +1,114 @@
+#include "beatTimeline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utilities/mappedFile.hpp>
+
+BeatTimeline::BeatTimeline(const double* timeStamps, const KeyFrameAction* actions, size_t count)
+    : mTimeStamps(timeStamps), mActions(actions), mCount(count) {}
+
+bool BeatTimeline::loadFile(std::string const &filename) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Could not open beat map " << filename << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(BeatMapFileHeader)) {
+        std::cerr << "Beat map " << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    BeatMapFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != beatMapFileMagic || header.version != beatMapFileVersion) {
+        std::cerr << "Beat map " << filename << " has an unknown format or version" << std::endl;
+        return false;
+    }
+
+    uint64_t expectedSize = sizeof(BeatMapFileHeader) + uint64_t(header.beatCount) * (sizeof(double) + sizeof(uint8_t));
+    if (header.beatCount == 0 || file.size() != expectedSize) {
+        std::cerr << "Beat map " << filename << " is malformed" << std::endl;
+        return false;
+    }
+
+    std::vector<double> timeStamps(header.beatCount);
+    std::vector<KeyFrameAction> actions(header.beatCount);
+    const unsigned char* timeTable   = file.data() + sizeof(BeatMapFileHeader);
+    const unsigned char* actionTable = timeTable + header.beatCount * sizeof(double);
+    std::memcpy(timeStamps.data(), timeTable, header.beatCount * sizeof(double));
+
+    for (uint32_t i = 0; i < header.beatCount; i++) {
+        if (!std::isfinite(timeStamps[i]) || actionTable[i] > TOP) {
+            std::cerr << "Beat map " << filename << " has a malformed key frame at index " << i << std::endl;
+            return false;
+        }
+        actions[i] = KeyFrameAction(actionTable[i]);
+
+        // Every key frame has to last a while, see advance()
+        if (i > 0 && timeStamps[i] <= timeStamps[i - 1]) {
+            std::cerr << "Beat map " << filename << " has a key frame out of order at index " << i << std::endl;
+            return false;
+        }
+    }
+
+    mLoadedTimeStamps = std::move(timeStamps);
+    mLoadedActions = std::move(actions);
+    mTimeStamps = mLoadedTimeStamps.data();
+    mActions = mLoadedActions.data();
+    mCount = mLoadedTimeStamps.size();
+    mCursor = 0;
+    return true;
+}
+
+bool BeatTimeline::writeFile(std::string const &filename) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Could not open " << filename << " for writing" << std::endl;
+        return false;
+    }
+
+    BeatMapFileHeader header;
+    header.magic     = beatMapFileMagic;
+    header.version   = beatMapFileVersion;
+    header.beatCount = uint32_t(mCount);
+    header.reserved  = 0;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(mTimeStamps), mCount * sizeof(double));
+    file.write(reinterpret_cast<const char*>(mActions), mCount * sizeof(KeyFrameAction));
+
+    return file.good();
+}
+
+size_t BeatTimeline::seek(double time) const {
+    // Last key frame that has started, or the first one if the song hasn't started yet
+    const double* next = std::upper_bound(mTimeStamps, mTimeStamps + mCount, time);
+    return next == mTimeStamps ? 0 : size_t(next - mTimeStamps) - 1;
+}
+
+BeatSegment BeatTimeline::advance(double time) {
+    if (time < mTimeStamps[mCursor]) {
+        mCursor = seek(time);
+    } else {
+        while (mCursor + 1 < mCount && mTimeStamps[mCursor + 1] <= time) {
+            mCursor++;
+        }
+    }
+
+    // The last key frame lasts forever
+    bool last = mCursor + 1 >= mCount;
+    double frameStart = mTimeStamps[mCursor];
+    double frameEnd = last ? std::numeric_limits<double>::infinity() : mTimeStamps[mCursor + 1];
+
+    BeatSegment segment;
+    segment.index       = mCursor;
+    segment.origin      = mActions[mCursor];
+    segment.destination = last ? mActions[mCursor] : mActions[mCursor + 1];
+    segment.fraction    = last ? 0.0 : (time - frameStart) / (frameEnd - frameStart);
+    return segment;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where the ball is headed at a key frame of the song
+enum KeyFrameAction : uint8_t {
+    BOTTOM, TOP
+};
+
+// Binary beat map files (.glbt)
+//
+//   BeatMapFileHeader
+//   double[beatCount]     key frame time stamps in seconds
+//   uint8_t[beatCount]    KeyFrameAction for every key frame
+//
+// Little endian, the time stamps start right after the 16 byte header so they are 8 byte aligned.
+
+const uint32_t beatMapFileMagic   = 0x54424C47; // "GLBT"
+const uint32_t beatMapFileVersion = 1;
+
+struct BeatMapFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t beatCount;
+    uint32_t reserved;
+};
+
+// The key frame the song is in at some point in time, and how far into it we are
+struct BeatSegment {
+    size_t index;
+    KeyFrameAction origin;
+    KeyFrameAction destination;
+    double fraction;
+};
+
+// Looks up the key frame for the current song time. Time usually only moves forward by a fraction of a beat
+// per step, so the cursor just walks ahead from where it was; jumping backwards falls back to a binary search.
+class BeatTimeline {
+public:
+    // Refers to the given arrays, which have to outlive the timeline (meant for the built-in constexpr tables)
+    BeatTimeline(const double* timeStamps, const KeyFrameAction* actions, size_t count);
+
+    // Replaces the key frames with the ones from a beat map file. Keeps the current ones and returns false if the
+    // file is missing or malformed.
+    bool loadFile(std::string const &filename);
+    bool writeFile(std::string const &filename) const;
+
+    // Moves the cursor to the key frame that contains `time` and returns where in it we are
+    BeatSegment advance(double time);
+
+    // Moves the cursor back to the start of the song
+    void rewind() { mCursor = 0; }
+
+    size_t cursor() const { return mCursor; }
+    size_t size() const { return mCount; }
+
+private:
+    size_t seek(double time) const;
+
+    const double* mTimeStamps;
+    const KeyFrameAction* mActions;
+    size_t mCount;
+    size_t mCursor = 0;
+
+    // Storage for key frames loaded from a file
+    std::vector<double> mLoadedTimeStamps;
+    std::vector<KeyFrameAction> mLoadedActions;
+};
@@ -0,0 +1,105 @@
+#include "benchmark.hpp"
+#include "program.hpp"
+#include "gamelogic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+
+// Frames rendered before measuring each configuration, lets buffers and shader caches settle
+const int benchmarkWarmupFrames = 5;
+const int benchmarkMeasuredFrames = 30;
+
+// The render paths every configuration is measured on, named as in the report
+struct BenchmarkPath {
+    const char* name;
+    bool rayTraced;
+    bool deferred;
+};
+const BenchmarkPath benchmarkPaths[] = {
+    { "raster",   false, false },
+    { "deferred", false, true },
+    { "raytrace", true,  false },
+};
+
+// Parses a comma separated list of non-negative counts, e.g. "0,50,100"
+static std::vector<unsigned int> parseCountList(std::string const &list) {
+    std::vector<unsigned int> counts;
+    std::stringstream stream(list);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        try {
+            counts.push_back((unsigned int) std::max(std::stoi(entry), 0));
+        } catch (const std::exception&) {
+            std::cerr << "Ignoring invalid benchmark count \"" << entry << "\"" << std::endl;
+        }
+    }
+    return counts;
+}
+
+void runBenchmark(GLFWwindow* window, CommandLineOptions options) {
+    std::vector<unsigned int> objectCounts = parseCountList(options.benchmarkObjectCounts);
+    std::vector<unsigned int> lightCounts  = parseCountList(options.benchmarkLightCounts);
+
+    std::ofstream report(options.benchmarkOutput);
+    if (report.fail()) {
+        std::cerr << "Could not open benchmark output file " << options.benchmarkOutput << std::endl;
+        return;
+    }
+    report << "path,objects,lights,triangles,draws,frame_ms_mean,frame_ms_min,frame_ms_max,upload_bytes,gather_ms\n";
+
+    // Don't let vsync cap the measured frame times
+    glfwSwapInterval(0);
+
+    reportTrophyGatherTime();
+
+    for (unsigned int objectCount : objectCounts) {
+        for (unsigned int lightCount : lightCounts) {
+            setStressScene(objectCount, lightCount, options.stressSeed);
+
+            for (BenchmarkPath const& path : benchmarkPaths) {
+                setRayTracingEnabled(path.rayTraced);
+                setDeferredShadingEnabled(path.deferred);
+
+                for (int i = 0; i < benchmarkWarmupFrames; i++) {
+                    runFrame(window);
+                }
+
+                double totalMs = 0;
+                double minMs = 1e30;
+                double maxMs = 0;
+                for (int i = 0; i < benchmarkMeasuredFrames; i++) {
+                    auto start = std::chrono::steady_clock::now();
+                    runFrame(window);
+                    glFinish(); // Include the GPU work of this frame
+                    auto end = std::chrono::steady_clock::now();
+
+                    double frameMs = std::chrono::duration<double, std::milli>(end - start).count();
+                    totalMs += frameMs;
+                    minMs = std::min(minMs, frameMs);
+                    maxMs = std::max(maxMs, frameMs);
+
+                    if (glfwWindowShouldClose(window)) {
+                        std::cout << "Benchmark aborted" << std::endl;
+                        return;
+                    }
+                }
+
+                FrameStats stats = getFrameStats();
+                std::string row = fmt::format("{},{},{},{},{},{:.3f},{:.3f},{:.3f},{},{:.3f}",
+                    path.name, objectCount, lightCount, stats.triangleCount, stats.drawCount,
+                    totalMs / benchmarkMeasuredFrames, minMs, maxMs, stats.uploadBytes, stats.gatherMs);
+                report << row << "\n";
+                report.flush();
+                std::cout << row << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Benchmark results written to " << options.benchmarkOutput << std::endl;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <utilities/window.hpp>
+
+// Sweeps the stress scene over the object and light counts given in the options, on the forward and deferred
+// raster paths and the ray tracing path, and writes frame time, triangle count and upload size per configuration to a CSV file
+void runBenchmark(GLFWwindow* window, CommandLineOptions options);
@@ -0,0 +1,55 @@
+#include "dynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Never trace fewer than this fraction of the pixels along each axis
+const float minTraceScale = 0.35f;
+
+// Adjust when the smoothed time leaves this band around the budget, so that the scale doesn't jitter
+const double overBudget  = 1.05;
+const double underBudget = 0.85;
+
+// Drop resolution quickly, raise it slowly
+const float maxScaleDrop = 0.9f;
+const float maxScaleRise = 1.05f;
+
+// Frames to wait after changing the bounce count, for the smoothed time to catch up
+const int bounceChangeCooldown = 30;
+
+DynamicResolution::DynamicResolution(double budgetMs, int maxBounces)
+    : mBudgetMs(budgetMs), mMaxBounces(maxBounces)
+{
+    reset();
+}
+
+void DynamicResolution::reset() {
+    mScale = 1.0f;
+    mBounceLimit = mMaxBounces;
+    mSmoothedMs = -1.0;
+    mFramesSinceBounceChange = 0;
+}
+
+void DynamicResolution::update(double gpuMs) {
+    mSmoothedMs = mSmoothedMs < 0 ? gpuMs : mSmoothedMs + 0.2 * (gpuMs - mSmoothedMs);
+    mFramesSinceBounceChange++;
+
+    if (mSmoothedMs > mBudgetMs * overBudget || mSmoothedMs < mBudgetMs * underBudget) {
+        // Tracing cost follows the pixel count, which goes with the square of the scale
+        float wanted = mScale * float(std::sqrt(mBudgetMs * 0.95 / std::max(mSmoothedMs, 1e-3)));
+        wanted = std::min(std::max(wanted, mScale * maxScaleDrop), mScale * maxScaleRise);
+        mScale = std::min(std::max(wanted, minTraceScale), 1.0f);
+    }
+
+    // Bounces only go once the resolution can't drop any further, and come back once it is at full resolution again
+    if (mFramesSinceBounceChange >= bounceChangeCooldown) {
+        if (mScale <= minTraceScale && mSmoothedMs > mBudgetMs * overBudget && mBounceLimit > 1) {
+            mBounceLimit--;
+            mFramesSinceBounceChange = 0;
+        }
+        else if (mScale >= 1.0f && mSmoothedMs < mBudgetMs * 0.6 && mBounceLimit < mMaxBounces) {
+            mBounceLimit++;
+            mFramesSinceBounceChange = 0;
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Picks the resolution the ray tracer traces at, and if that isn't enough the number of bounces, so that the
+// GPU time of ray tracing stays within a budget. The traced image is upscaled to the window afterwards.
+class DynamicResolution {
+public:
+    DynamicResolution(double budgetMs, int maxBounces);
+
+    // Feeds the GPU time of a traced frame
+    void update(double gpuMs);
+
+    // Goes back to full resolution and all bounces
+    void reset();
+
+    // Fraction of the window width and height that is traced
+    float scale() const { return mScale; }
+    int bounceLimit() const { return mBounceLimit; }
+    double budgetMs() const { return mBudgetMs; }
+
+private:
+    double mBudgetMs;
+    int mMaxBounces;
+
+    float mScale;
+    int mBounceLimit;
+    double mSmoothedMs;
+    int mFramesSinceBounceChange;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <utilities/bounds.h>
+#include "sceneGraph.hpp"
+#include "triangleGather.hpp"
+
+// Everything renderFrame() needs of one simulated frame. The simulation thread fills one snapshot while the GL
+// thread renders the previous one, so nothing in here may point into the scene graph, which keeps changing.
+
+// Struct to hold the data for the light sources for the GPU
+struct LightSourceData {
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+// A 3D node to draw, only nodes inside the view frustum make it in when frustum culling is on
+struct DrawItem {
+    glm::mat4 modelViewProjection;
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix;
+
+    SceneNodeType nodeType;
+    int vertexArrayObjectID;
+    unsigned int indexCount;
+    unsigned int textureID;
+    unsigned int normalMapID;
+    unsigned int roughnessMapID;
+    unsigned int materialID;
+
+    AABB worldBounds;
+};
+
+// A 2D (text) node to draw on top of everything
+struct DrawItem2D {
+    glm::mat4 modelMatrix;
+    int vertexArrayObjectID;
+    unsigned int indexCount;
+    unsigned int textureID;
+};
+
+// The toggles as they were when the frame was simulated, so that a key press can't change them halfway through
+struct FrameSettings {
+    bool rayTracing;
+    bool gpuTransform;
+    bool occlusionCulling;
+    int rayTracingBounces;
+    bool dynamicResolution;
+    bool temporalReprojection;
+    bool hybridPrimary;
+    bool wavefront;
+    bool tileBinning;
+    int lightSamples;   // 0 shades every light
+    bool lightReuse;
+    bool clusteredShading;
+    bool deferredShading;
+    bool depthPrepass;
+};
+
+struct FrameSnapshot {
+    FrameSettings settings;
+
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    glm::vec3 ballPosition;
+    AABB boxBounds;     // the box enclosure, empty if the scene has none
+
+    std::vector<LightSourceData> lights;
+    std::vector<DrawItem> drawList;       // in scene graph order
+    std::vector<DrawItem2D> drawList2D;
+
+    // Mesh instances for the ray tracer, and their world space triangles if they were transformed on the CPU
+    std::vector<GatherJob> gatherJobs;
+    std::vector<Triangle> triangles;
+    size_t triangleCount = 0;
+    double gatherMs = 0.0;
+};
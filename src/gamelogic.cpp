@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <utilities/shader.hpp>
@@ -20,20 +22,32 @@
 
 #include "utilities/imageLoader.hpp"
 #include "utilities/glfont.h"
-
-enum KeyFrameAction {
-    BOTTOM, TOP
-};
+#include "stressScene.hpp"
+#include "sceneFile.hpp"
+#include "occlusionCulling.hpp"
+#include "triangleGather.hpp"
+#include "gpuTransform.hpp"
+#include "utilities/frameRing.hpp"
+#include "utilities/workerThread.hpp"
+#include "frameSnapshot.hpp"
+#include "utilities/shaderVariants.hpp"
+#include "rayTracerTuning.hpp"
+#include "dynamicResolution.hpp"
+#include "utilities/gpuTimer.hpp"
+#include "wavefront.hpp"
+#include "triangleBinning.hpp"
+#include "lightClustering.hpp"
 
 #include <timestamps.h>
+#include <thread>
 #include <unordered_map>
 #include "utilities/camera.hpp"
 
 double padPositionX = 0;
 double padPositionZ = 0;
 
-unsigned int currentKeyFrame = 0;
-unsigned int previousKeyFrame = 0;
+BeatTimeline beatTimeline(keyFrameTimeStamps, keyFrameDirections, sizeof(keyFrameTimeStamps) / sizeof(keyFrameTimeStamps[0]));
+size_t previousKeyFrame = 0;
 
 SceneNode* rootNode;
 SceneNode* boxNode;
@@ -42,17 +56,119 @@ SceneNode* padNode;
 
 SceneNode* trophySimpleNode;
 
+// Parent of the generated stress scene, sits in the middle of the box
+SceneNode* stressSceneNode = nullptr;
+StressSceneMeshes stressMeshes;
+
 double ballRadius = 3.0f;
 
 // These are heap allocated, because they should not be initialised at the start of the program
-Gloom::Shader* shader;
+ShaderVariants* sceneShaders;
+ShaderVariants* rayTracerShaders;
 Gloom::Shader* shader2D;
-Gloom::Shader* computeShader;
 
-unsigned int rayTracedTexture;
+// The ray tracer writes one of each and reads last frame's result back from the other
+unsigned int rayTracedTextures[2];
+unsigned int rayDistanceTextures[2];
+int rayTracedTextureIndex = 0;
+
+// Formats the ray traced color can be stored in, the name is the matching GLSL image format
+struct RayTracingOutputFormat {
+    const char* name;
+    GLenum internalFormat;
+};
+const RayTracingOutputFormat rayTracingOutputFormats[] = {
+    { "r11f_g11f_b10f", GL_R11F_G11F_B10F },
+    { "rgba16f",        GL_RGBA16F },
+    { "rgba32f",        GL_RGBA32F },
+};
+RayTracingOutputFormat rayTracingOutputFormat = rayTracingOutputFormats[0];
 unsigned int fullScreenQuadVAO; // for drawing a full-screen quad
 bool rtEnabled = true;  // Ray tracing enabled by default, bool to track/toggle it
 
+// Ray tracer variant, both are compiled into the shader. The layout comes from the autotuner if it has run on this GPU.
+int rayTracingBounces = 3;
+const int maxRayTracingBounces = 4;
+RayTracerLayout rayTracerLayout;
+
+// Dynamic resolution, traces fewer pixels when ray tracing takes longer than its share of the frame time
+bool dynamicResolutionEnabled = false;
+const double rayTracingFrameShare = 0.8;
+DynamicResolution* dynamicResolution;
+GpuTimer* rayTracingTimer;
+Gloom::Shader* upscaleShader;
+
+// Tile binning, primary rays only test the triangles whose screen space bounds overlap their work group's tile
+bool tileBinningEnabled = true;
+
+// Wavefront ray tracing, every bounce runs as separate passes over queues of the rays that are still alive
+bool wavefrontEnabled = false;
+
+// Depth prepass of the forward raster path, the depth is laid down with a position-only shader first and the shading
+// pass tests GL_EQUAL without writing depth, so every pixel is shaded once
+bool depthPrepassEnabled = false;
+Gloom::Shader* depthPrepassShader;
+
+// Position-only vertex arrays for the depth prepass, keyed by the full vertex array they share buffers with
+std::unordered_map<int, unsigned int> positionOnlyVertexArrays;
+
+// Deferred shading of the raster path, the geometry only writes a G-buffer (depth, octahedral normal, albedo and
+// roughness) and one full-screen pass shades every pixel once
+bool deferredShadingEnabled = false;
+ShaderVariants* deferredLightingShaders;
+unsigned int deferredFramebuffer;
+unsigned int deferredDepthTexture;
+unsigned int deferredNormalTexture;
+unsigned int deferredAlbedoTexture;
+
+// Clustered forward shading, fragments of the raster path only loop over the lights that reach their cluster
+bool clusteredShadingEnabled = true;
+
+// Light sampling, hits trace shadow rays toward a few lights picked by weighted reservoir sampling instead of toward
+// every light. The primary hits can also reuse the reservoirs of their neighbours and of last frame.
+enum LightSampling { ALL_LIGHTS, SAMPLED_LIGHTS, REUSED_LIGHT_SAMPLES };
+LightSampling lightSampling = ALL_LIGHTS;
+int lightSamplesPerHit = 1;
+unsigned int lightReservoirBuffers[2] = {0, 0};
+int lightReservoirIndex = 0;
+size_t lightReservoirCapacity = 0;  // reservoirs per buffer
+
+// What the reservoirs in lightReservoirBuffers[lightReservoirIndex] were written for
+struct LightReservoirHistory {
+    bool valid = false;
+    glm::ivec2 traceSize;
+    int samples;
+    size_t lightCount;
+};
+LightReservoirHistory lightReservoirHistory;
+
+// Hybrid rendering, the primary hits are rasterized into a thin G-buffer and only the secondary rays are traced
+bool hybridPrimaryEnabled = false;
+Gloom::Shader* gbufferShader;
+unsigned int gbufferFramebuffer;
+unsigned int gbufferDepthTexture;
+unsigned int gbufferNormalTexture;
+unsigned int gbufferMaterialTexture;
+
+// Temporal reprojection, only a quarter of the pixels are traced each frame and the rest reuse last frame's image
+bool temporalReprojectionEnabled = true;
+
+// What the image in the history texture was traced with, it can only be reused if nothing but the camera and the ball changed
+struct RayTracingHistory {
+    bool valid = false;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    glm::vec3 ballPosition;
+    glm::ivec2 traceSize;
+    int bounces;
+    bool hybrid;        // traced from the rasterized primary hits
+    bool wavefront;     // traced by the wavefront passes
+    size_t triangleCount;
+    std::vector<LightSourceData> lights;
+    int tracePhase = 0;
+};
+RayTracingHistory rayTracingHistory;
+
 // Global camera pointer
 glm::vec3 initialCameraPosition = glm::vec3(0, 2, -20);
 Gloom::Camera* freeCam = new Gloom::Camera(initialCameraPosition, 8.0f, 0.005f);
@@ -60,29 +176,325 @@ bool freeCameraActive = false;
 
 
 // Struct to hold the data for the light sources for the GPU
-struct LightSourceData {
+// Lights found while updating the transformations, moved into the snapshot once the frame is simulated
+static std::vector<LightSourceData> lightsData;
+
+// std430 layout of the Lights storage buffer in simple.frag and raytracer.comp, a header followed by the lights
+struct LightBufferHeader {
+    GLint numLights; GLint pad0, pad1, pad2;
+};
+
+struct ShaderLight {
     glm::vec3 position;
+    float radius;
     glm::vec3 color;
+    float pad0;
 };
 
-static std::vector<LightSourceData> lightsData;
+// Distance attenuation, must match simple.frag and raytracer.comp
+const float attenuationConstant  = 0.0011f;
+const float attenuationLinear    = 0.0014f;
+const float attenuationQuadratic = 0.0038f;
+
+// A light is culled where its brightest channel has attenuated below one step of an 8 bit color
+const float lightCutoff = 1.0f / 256.0f;
+
+// How far a light of the given color reaches before it falls below lightCutoff
+float lightRadius(glm::vec3 color) {
+    float brightness = std::max(color.r, std::max(color.g, color.b));
+
+    // Solve brightness / (c + l*d + q*d^2) = cutoff for d
+    float constant = attenuationConstant - brightness / lightCutoff;
+    if (constant >= 0.0f) {
+        return 0.0f;
+    }
+    float discriminant = attenuationLinear * attenuationLinear - 4.0f * attenuationQuadratic * constant;
+    return (-attenuationLinear + std::sqrt(discriminant)) / (2.0f * attenuationQuadratic);
+}
+
+// What simple.frag is compiled for: shading the geometry directly, or one of the two passes of deferred shading
+enum ScenePass { FORWARD_PASS, GBUFFER_PASS, LIGHTING_PASS };
+
+// The #defines of the scene shader variant for plain or normal mapped geometry, looping over the lights of the
+// fragment's cluster instead of over every light if `clustered` is set
+Gloom::ShaderDefines sceneVariant(bool normalMapped, bool clustered, ScenePass pass = FORWARD_PASS) {
+    Gloom::ShaderDefines defines;
+    if (normalMapped) {
+        defines.push_back({"USE_NORMAL_MAP", "1"});
+    }
+    if (clustered) {
+        defines.push_back({"CLUSTERED_LIGHTS", "1"});
+    }
+    if (pass == GBUFFER_PASS) {
+        defines.push_back({"DEFERRED_GBUFFER", "1"});
+    } else if (pass == LIGHTING_PASS) {
+        defines.push_back({"DEFERRED_LIGHTING", "1"});
+    }
+    return defines;
+}
+
+// What a ray tracer variant is compiled for, besides its work group layout
+struct RayTracerFeatures {
+    int bounces;                // rays are followed for this many bounces
+    bool hybrid = false;        // starts from the G-buffer instead of tracing the primary rays
+    bool binned = false;        // walks the per-tile triangle lists for primary rays
+    int lightSamples = 0;       // lights picked per hit, 0 shades every light
+    bool lightReuse = false;    // primary hits reuse the light reservoirs of their neighbours and last frame
+};
+
+// Triangles a work group of `groupThreads` threads loads into shared memory at a time: one per thread up to 256, and
+// no more than fit next to the light reuse arrays in the shared memory this GPU has. Shared vec3s are counted as
+// 16 bytes, since drivers pad them.
+int triangleBatchSize(int groupThreads, bool lightReuse) {
+    static GLint sharedBytes = 0;
+    if (sharedBytes == 0) {
+        glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &sharedBytes);
+    }
+    const int bytesPerTriangle = 4 + 6 * 16;      // batchTriangle and the six batch vectors
+    const int reuseBytesPerThread = 16 + 16;      // neighbourReservoirs and neighbourSurfaces
+    const int otherBytes = 64;                    // workGroupVote, with room to spare
+    int available = int(sharedBytes) - otherBytes - (lightReuse ? groupThreads * reuseBytesPerThread : 0);
+    return std::max(1, std::min(std::min(groupThreads, 256), available / bytesPerTriangle));
+}
+
+// The #defines of the ray tracer variant with the given features
+Gloom::ShaderDefines rayTracerVariant(RayTracerFeatures const& features, RayTracerLayout const& layout = rayTracerLayout) {
+    Gloom::ShaderDefines defines = {
+        {"MAX_BOUNCES",   std::to_string(features.bounces)},
+        {"LOCAL_SIZE_X",  std::to_string(layout.localSizeX)},
+        {"LOCAL_SIZE_Y",  std::to_string(layout.localSizeY)},
+        {"PIXEL_MAPPING", std::to_string(int(layout.mapping))},
+        {"OUTPUT_FORMAT", rayTracingOutputFormat.name},
+    };
+    bool lightReuse = features.lightSamples > 0 && features.lightReuse;
+    int groupThreads = layout.localSizeX * layout.localSizeY;
+    defines.push_back({"TRIANGLE_BATCH_SIZE", std::to_string(triangleBatchSize(groupThreads, lightReuse))});
+    if (features.hybrid) {
+        defines.push_back({"HYBRID_PRIMARY", "1"});
+    }
+    if (features.binned) {
+        defines.push_back({"TILE_BINNING", "1"});
+    }
+    if (features.lightSamples > 0) {
+        defines.push_back({"LIGHT_SAMPLES", std::to_string(features.lightSamples)});
+        if (features.lightReuse) {
+            defines.push_back({"LIGHT_REUSE", "1"});
+        }
+    }
+    return defines;
+}
+
+// The #defines of one pass of the wavefront version of the same ray tracer variant, which neither bins
+// triangles nor reuses light reservoirs
+Gloom::ShaderDefines wavefrontVariant(RayTracerFeatures features, WavefrontStage stage) {
+    features.binned = false;
+    features.lightReuse = false;
+    Gloom::ShaderDefines defines = rayTracerVariant(features);
+
+    // The passes over a queue have work groups of their own size
+    int groupThreads = rayTracerLayout.localSizeX * rayTracerLayout.localSizeY;
+    if (stage == WAVEFRONT_PREPARE) {
+        groupThreads = 1;
+    } else if (stage == WAVEFRONT_INTERSECT || stage == WAVEFRONT_SHADE || stage == WAVEFRONT_SHADOW) {
+        groupThreads = wavefrontGroupSize;
+    }
+    for (auto& define : defines) {
+        if (define.first == "TRIANGLE_BATCH_SIZE") {
+            define.second = std::to_string(triangleBatchSize(groupThreads, false));
+        }
+    }
+
+    defines.push_back({"WAVEFRONT_STAGE", std::to_string(int(stage))});
+    defines.push_back({"WAVEFRONT_GROUP_SIZE", std::to_string(wavefrontGroupSize)});
+    return defines;
+}
+
+// std140 layout of the Camera uniform block in raytracer.comp
+struct CameraBlock {
+    glm::mat4 invProjection;
+    glm::mat4 invView;
+    glm::vec4 cameraPosition; // w unused
+    glm::vec4 ambientColor;   // w unused
+
+    glm::mat4 viewProjection;
+    glm::mat4 previousViewProjection;
+    glm::mat4 previousInvViewProjection;
+    glm::vec4 previousCameraPosition; // w unused
+    glm::vec4 ballBounds;
+    glm::vec4 previousBallBounds;
+    glm::vec4 enclosureMin;   // w is 1 if there is an enclosure
+    glm::vec4 enclosureMax;
+    GLint tracePhase;
+    GLuint frameSeed;
+    GLint reservoirHistory;
+    GLint pad0;
+};
+
+// Initial size of one frame in the frame ring, it grows to whatever the largest frame needs
+const size_t frameRingInitialBytes = 4 * 1024 * 1024;
+
+// Bytes sent to the GPU (buffers and uniforms) and draw calls issued during the last frame, for the benchmark harness
+static size_t frameUploadBytes = 0;
+static size_t frameDrawCount = 0;
+
+// View frustum of the current frame, nodes outside of it are not drawn
+static Frustum viewFrustum;
+bool frustumCullingEnabled = true;
+
+// GPU occlusion culling of the drawn nodes against the previous frame's depth
+bool occlusionCullingEnabled = true;
+static std::vector<OcclusionInstance> occlusionInstances;
+
+// Everything secondary (shadow and reflection) rays of the current frame can reach. Instances outside of it
+// are left out of the ray tracer. Inside the box it is at most the box, whose walls stop every ray; elsewhere it is
+// unbounded once reflections are traced, since reflected rays can then go anywhere.
+static AABB rtSecondaryRegion;
+static bool rtSecondaryRegionUnbounded = true;
+
+static size_t frameTriangleCount = 0;
+
+// Transform the ray tracer's triangles in a compute pre-pass instead of on the CPU
+bool gpuTransformEnabled = true;
+
+// Workers for the triangle gather, the main thread makes one more
+static ThreadPool* gatherPool = nullptr;
+static double frameGatherMs = 0.0;
+
+// The toggles as they are right now, the simulation thread hands them over with every frame
+FrameSettings currentFrameSettings() {
+    FrameSettings settings;
+    settings.rayTracing           = rtEnabled;
+    settings.gpuTransform         = gpuTransformEnabled;
+    settings.occlusionCulling     = occlusionCullingEnabled;
+    settings.rayTracingBounces    = rayTracingBounces;
+    settings.dynamicResolution    = dynamicResolutionEnabled;
+    settings.temporalReprojection = temporalReprojectionEnabled;
+    settings.hybridPrimary        = hybridPrimaryEnabled;
+    settings.wavefront            = wavefrontEnabled;
+    settings.tileBinning          = tileBinningEnabled;
+    settings.lightSamples         = lightSampling == ALL_LIGHTS ? 0 : lightSamplesPerHit;
+    settings.lightReuse           = lightSampling == REUSED_LIGHT_SAMPLES;
+    settings.clusteredShading     = clusteredShadingEnabled;
+    settings.deferredShading      = deferredShadingEnabled;
+    settings.depthPrepass         = depthPrepassEnabled;
+    return settings;
+}
+
+// The ray tracer variant a frame with the given settings is traced with, at `bounces` bounces.
+// Only the megakernel traces primary rays in tiles, one per work group, and reuses light reservoirs.
+RayTracerFeatures rayTracerFeatures(FrameSettings const& settings, int bounces) {
+    RayTracerFeatures features;
+    features.bounces      = bounces;
+    features.hybrid       = settings.hybridPrimary;
+    features.binned       = settings.tileBinning && !features.hybrid && !settings.wavefront;
+    features.lightSamples = settings.lightSamples;
+    features.lightReuse   = settings.lightReuse && features.lightSamples > 0 && !settings.wavefront;
+    return features;
+}
+
+// The programs a frame traced with the given features runs: the megakernel, or every pass of the wavefront tracer
+std::vector<Gloom::ShaderDefines> rayTracerPrograms(RayTracerFeatures const& features, bool wavefront) {
+    if (!wavefront) {
+        return {rayTracerVariant(features)};
+    }
+    std::vector<Gloom::ShaderDefines> programs;
+    for (WavefrontStage stage : {WAVEFRONT_GENERATE, WAVEFRONT_PREPARE, WAVEFRONT_INTERSECT,
+                                 WAVEFRONT_SHADE, WAVEFRONT_SHADOW, WAVEFRONT_RESOLVE}) {
+        programs.push_back(wavefrontVariant(features, stage));
+    }
+    return programs;
+}
+
+// Ray tracer variants still to be compiled in the background, one after every frame. Startup only compiles what the
+// first frame uses. The lower bounce counts (dynamic resolution drops to them by itself in a frame that is already
+// over budget) and the other modes follow here, listed again whenever the layout or the light sampling changes.
+static std::vector<Gloom::ShaderDefines> backgroundRayTracerVariants;
+static Gloom::ShaderDefines backgroundVariantsListedFor;
+
+// Lists every variant the frame loop can pick with the layout and light sampling of `settings`, the current mode first
+void listBackgroundRayTracerVariants(FrameSettings const& settings) {
+    backgroundRayTracerVariants.clear();
+    backgroundVariantsListedFor = rayTracerVariant(rayTracerFeatures(settings, 1));
+
+    FrameSettings mode = settings;
+    auto listMode = [&mode]() {
+        for (int bounces = maxRayTracingBounces; bounces >= 1; bounces--) {
+            for (Gloom::ShaderDefines const& program : rayTracerPrograms(rayTracerFeatures(mode, bounces), mode.wavefront)) {
+                backgroundRayTracerVariants.push_back(program);
+            }
+        }
+    };
+    listMode();
+    for (bool wavefront : {false, true}) {
+        for (bool hybrid : {false, true}) {
+            for (bool binned : {false, true}) {
+                if (binned && (hybrid || wavefront)) {
+                    continue;
+                }
+                mode.wavefront     = wavefront;
+                mode.hybridPrimary = hybrid;
+                mode.tileBinning   = binned;
+                listMode();
+            }
+        }
+    }
+
+    // Popped from the back
+    std::reverse(backgroundRayTracerVariants.begin(), backgroundRayTracerVariants.end());
+}
 
-struct Triangle {
-    // vec3 + padding to align to 16 bytes due to std140 layout
-    // v is world space vertex, n is normal
-    glm::vec3 v0; float pad0;
-    glm::vec3 v1; float pad1;
-    glm::vec3 v2; float pad2;
-    glm::vec3 n0; float pad3;
-    glm::vec3 n1; float pad4;
-    glm::vec3 n2; float pad5;
-    unsigned int materialID; float pad6; float pad7; float pad8;
+// Starts compiling the next background variant, called once a frame is done
+void prepareBackgroundRayTracerVariant(FrameSettings const& settings) {
+    if (rayTracerVariant(rayTracerFeatures(settings, 1)) != backgroundVariantsListedFor) {
+        listBackgroundRayTracerVariants(settings);
+    }
+    if (!backgroundRayTracerVariants.empty()) {
+        rayTracerShaders->prepare(backgroundRayTracerVariants.back());
+        backgroundRayTracerVariants.pop_back();
+    }
+}
+
+// Frames are simulated on their own thread one frame ahead of rendering. The GL thread renders `renderedFrame`
+// while the simulation thread fills `simulatedFrame`, and they swap once both are done.
+static FrameSnapshot frameSnapshots[2];
+static FrameSnapshot* renderedFrame  = &frameSnapshots[0];
+static FrameSnapshot* simulatedFrame = &frameSnapshots[1];
+static WorkerThread* simulationThread = nullptr;
+
+// GLFW only delivers input on the main thread, so it is collected there and handed to the simulation with each frame
+struct KeyEvent {
+    int key;
+    int action;
 };
 
+struct FrameInput {
+    std::vector<KeyEvent> keyEvents;
+    double padDeltaX = 0;
+    double padDeltaZ = 0;
+    bool mouseLeft  = false;
+    bool mouseRight = false;
+};
 
-static std::vector<Triangle> allTriangles;
+static FrameInput pendingInput;     // main thread only
+static FrameInput simulationInput;  // simulation thread only, while a frame is being simulated
 static std::unordered_map<int, Mesh> gMeshByVao;
 
+// Meshes and textures by the name scene files refer to them with
+static std::unordered_map<std::string, int> gVaoByMeshName;
+static std::unordered_map<int, std::string> gMeshNameByVao;
+static std::unordered_map<std::string, unsigned int> gTextureByName;
+static std::unordered_map<unsigned int, std::string> gTextureNameById;
+
+// Meshes generated in code rather than loaded from an OBJ file
+const std::string boxMeshName    = "builtin:box";
+const std::string padMeshName    = "builtin:pad";
+const std::string sphereMeshName = "builtin:sphere";
+const std::string cubeMeshName   = "builtin:cube";   // unit cube, used by the stress scene
+const std::string textMeshPrefix = "text:";          // followed by the text to show
+
+const std::string trophyModelPath       = "../res/models/trophy.obj";
+const std::string trophySimpleModelPath = "../res/models/trophy_simple.obj";
+
 struct Material {
     glm::vec3 baseColor; // 12 bytes; will be padded to 16 bytes
     float pad0;         // padding so that baseColor occupies 16 bytes
@@ -105,6 +517,12 @@ std::vector<Material> gMaterials = {
 };
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    // Applied by the simulation thread at the start of the next frame
+    pendingInput.keyEvents.push_back({key, action});
+}
+
+void applyKeyEvent(int key, int action)
 {
     // Toggle ray tracing on 'R' press
     if (key == GLFW_KEY_R && action == GLFW_PRESS) {
@@ -131,6 +549,122 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         }
     }
 
+    // Toggle frustum culling on 'F' press
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        frustumCullingEnabled = !frustumCullingEnabled;
+        if (frustumCullingEnabled)
+            std::cout << "Frustum culling ENABLED\n";
+        else
+            std::cout << "Frustum culling DISABLED\n";
+    }
+
+    // Toggle occlusion culling on 'O' press
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        occlusionCullingEnabled = !occlusionCullingEnabled;
+        if (occlusionCullingEnabled)
+            std::cout << "Occlusion culling ENABLED\n";
+        else
+            std::cout << "Occlusion culling DISABLED\n";
+    }
+
+    // Toggle the GPU triangle transform on 'G' press
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        gpuTransformEnabled = !gpuTransformEnabled;
+        if (gpuTransformEnabled)
+            std::cout << "GPU triangle transform ENABLED\n";
+        else
+            std::cout << "GPU triangle transform DISABLED\n";
+    }
+
+    // Cycle the number of ray tracing bounces on 'B' press
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        rayTracingBounces = rayTracingBounces % maxRayTracingBounces + 1;
+        std::cout << "Ray tracing bounces: " << rayTracingBounces << "\n";
+    }
+
+    // Toggle dynamic resolution on 'V' press
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        dynamicResolutionEnabled = !dynamicResolutionEnabled;
+        if (dynamicResolutionEnabled)
+            std::cout << "Dynamic resolution ENABLED\n";
+        else
+            std::cout << "Dynamic resolution DISABLED\n";
+    }
+
+    // Toggle hybrid rendering on 'Y' press
+    if (key == GLFW_KEY_Y && action == GLFW_PRESS) {
+        hybridPrimaryEnabled = !hybridPrimaryEnabled;
+        if (hybridPrimaryEnabled)
+            std::cout << "Hybrid rendering ENABLED\n";
+        else
+            std::cout << "Hybrid rendering DISABLED\n";
+    }
+
+    // Toggle the depth prepass of the forward raster path on 'Z' press
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        depthPrepassEnabled = !depthPrepassEnabled;
+        if (depthPrepassEnabled)
+            std::cout << "Depth prepass ENABLED\n";
+        else
+            std::cout << "Depth prepass DISABLED\n";
+    }
+
+    // Toggle deferred shading of the raster path on 'N' press
+    if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+        deferredShadingEnabled = !deferredShadingEnabled;
+        if (deferredShadingEnabled)
+            std::cout << "Deferred shading ENABLED\n";
+        else
+            std::cout << "Deferred shading DISABLED\n";
+    }
+
+    // Toggle clustered shading of the raster path on 'X' press
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+        clusteredShadingEnabled = !clusteredShadingEnabled;
+        if (clusteredShadingEnabled)
+            std::cout << "Clustered shading ENABLED\n";
+        else
+            std::cout << "Clustered shading DISABLED\n";
+    }
+
+    // Cycle between shading every light, sampled lights and sampled lights with reservoir reuse on 'L' press
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        lightSampling = LightSampling((lightSampling + 1) % 3);
+        if (lightSampling == ALL_LIGHTS)
+            std::cout << "Light sampling: all lights\n";
+        else if (lightSampling == SAMPLED_LIGHTS)
+            std::cout << "Light sampling: " << lightSamplesPerHit << " per hit\n";
+        else
+            std::cout << "Light sampling: " << lightSamplesPerHit << " per hit, reservoirs reused\n";
+    }
+
+    // Toggle tile binning of the primary rays on 'J' press
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+        tileBinningEnabled = !tileBinningEnabled;
+        if (tileBinningEnabled)
+            std::cout << "Tile binning ENABLED\n";
+        else
+            std::cout << "Tile binning DISABLED\n";
+    }
+
+    // Toggle the wavefront ray tracer on 'K' press
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        wavefrontEnabled = !wavefrontEnabled;
+        if (wavefrontEnabled)
+            std::cout << "Wavefront ray tracing ENABLED\n";
+        else
+            std::cout << "Wavefront ray tracing DISABLED\n";
+    }
+
+    // Toggle temporal reprojection on 'H' press
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        temporalReprojectionEnabled = !temporalReprojectionEnabled;
+        if (temporalReprojectionEnabled)
+            std::cout << "Temporal reprojection ENABLED\n";
+        else
+            std::cout << "Temporal reprojection DISABLED\n";
+    }
+
     // Toggle free camera on 'C' press
     if (key == GLFW_KEY_C && action == GLFW_PRESS)
     {
@@ -148,9 +682,8 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     }
 }
 
-GLuint triangleSSBO = 0;
-GLuint materialSSBO = 0;
 
+const glm::vec3 boxPosition(0, -10, -80);
 const glm::vec3 boxDimensions(180, 90, 90);
 const glm::vec3 padDimensions(30, 3, 40);
 
@@ -172,6 +705,34 @@ bool mouseRightReleased = false;
 double totalElapsedTime = 0;
 double gameElapsedTime  = 0;
 
+// The game advances in fixed steps of this length, independent of the frame rate
+const double gameTimeStep = 1.0 / 120.0;
+const int maxGameStepsPerFrame = 8;
+double gameTimeAccumulator = 0;
+
+// The part of the game state that is drawn, interpolated between the last two steps
+struct GameState {
+    glm::vec3 ballPosition;
+    double padPositionX;
+    double padPositionZ;
+    double totalElapsedTime;
+};
+
+GameState previousGameState;
+
+GameState currentGameState() {
+    return { ballPosition, padPositionX, padPositionZ, totalElapsedTime };
+}
+
+GameState interpolateGameState(GameState const& from, GameState const& to, double t) {
+    return {
+        glm::mix(from.ballPosition, to.ballPosition, float(t)),
+        from.padPositionX + (to.padPositionX - from.padPositionX) * t,
+        from.padPositionZ + (to.padPositionZ - from.padPositionZ) * t,
+        from.totalElapsedTime + (to.totalElapsedTime - from.totalElapsedTime) * t
+    };
+}
+
 double mouseSensitivity = 1.0;
 double lastMouseX = windowWidth / 2;
 double lastMouseY = windowHeight / 2;
@@ -184,53 +745,97 @@ void mouseCallback(GLFWwindow* window, double x, double y) {
     double deltaX = x - lastMouseX;
     double deltaY = y - lastMouseY;
 
-    padPositionX -= mouseSensitivity * deltaX / windowWidth;
-    padPositionZ -= mouseSensitivity * deltaY / windowHeight;
-
-    if (padPositionX > 1) padPositionX = 1;
-    if (padPositionX < 0) padPositionX = 0;
-    if (padPositionZ > 1) padPositionZ = 1;
-    if (padPositionZ < 0) padPositionZ = 0;
+    // The pad itself is moved by the simulation thread
+    pendingInput.padDeltaX -= mouseSensitivity * deltaX / windowWidth;
+    pendingInput.padDeltaZ -= mouseSensitivity * deltaY / windowHeight;
 
     glfwSetCursorPos(window, windowWidth / 2, windowHeight / 2);
 }
 
 
-void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
-    options = gameOptions;
+// Creates the mesh a scene file refers to with the given name
+Mesh createNamedMesh(std::string const &name) {
+    if (name == boxMeshName) {
+        Mesh box = cube(boxDimensions, glm::vec2(90), true, true);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
-    glfwSetCursorPosCallback(window, mouseCallback);
+        // Generate TBN for the box before sending data to the GPU (in #generateBuffer())
+        computeTangentsAndBitangents(box);
+        return box;
+    }
+    if (name == padMeshName)    return cube(padDimensions, glm::vec2(30, 40), true);
+    if (name == sphereMeshName) return generateSphere(1.0, 40, 40);
+    if (name == cubeMeshName)   return cube(glm::vec3(1));
+
+    if (name.compare(0, textMeshPrefix.size(), textMeshPrefix) == 0) {
+        float ratio = 39.0f / 29.0f;  // height / width
+        float totalWidth = 200.0f;    // good enough for this text?
+        return generateTextGeometryBuffer(name.substr(textMeshPrefix.size()), ratio, totalWidth);
+    }
 
-    shader = new Gloom::Shader();
-    shader->makeBasicShader("../res/shaders/simple.vert", "../res/shaders/simple.frag");
-    shader->activate();
+    return loadOBJ(name);
+}
 
-    // Create meshes
-    Mesh pad = cube(padDimensions, glm::vec2(30, 40), true);
-    Mesh box = cube(boxDimensions, glm::vec2(90), true, true);
-    Mesh sphere = generateSphere(1.0, 40, 40);
+// Returns the VAO of the named mesh, creating and uploading it on first use
+int loadNamedMesh(std::string const &name, unsigned int &indexCount) {
+    auto it = gVaoByMeshName.find(name);
+    if (it == gVaoByMeshName.end()) {
+        Mesh mesh = createNamedMesh(name);
+        mesh.bounds = computeBounds(mesh.vertices);
+        int vao = generateBuffer(mesh);
+
+        // Store the meshes in a map for easy access for ray tracing
+        gMeshByVao.insert({vao, mesh});
+        gMeshNameByVao.insert({vao, name});
+        it = gVaoByMeshName.insert({name, vao}).first;
+    }
+
+    indexCount = gMeshByVao.at(it->second).indices.size();
+    return it->second;
+}
 
-    Mesh trophy = loadOBJ("../res/models/trophy.obj");
-    Mesh trophySimple = loadOBJ("../res/models/trophy_simple.obj");
+// Returns the ID of the named texture, loading it on first use
+unsigned int loadNamedTexture(std::string const &name) {
+    auto it = gTextureByName.find(name);
+    if (it == gTextureByName.end()) {
+        PNGImage image = loadPNGFile(name);
+        unsigned int textureID = createTexture(image);
 
-    // Generate TBN for the box before sending data to the GPU (in #generateBuffer())
-    computeTangentsAndBitangents(box);
+        gTextureNameById.insert({textureID, name});
+        it = gTextureByName.insert({name, textureID}).first;
+    }
+    return it->second;
+}
 
-    // Fill buffers
-    unsigned int ballVAO = generateBuffer(sphere);
-    unsigned int boxVAO  = generateBuffer(box);
-    unsigned int padVAO  = generateBuffer(pad);
+StressMesh loadStressMesh(std::string const &name) {
+    StressMesh mesh;
+    mesh.vertexArrayObjectID = loadNamedMesh(name, mesh.indexCount);
+    mesh.unitScale = unitScaleForMesh(gMeshByVao.at(mesh.vertexArrayObjectID));
+    return mesh;
+}
 
-    unsigned int trophyVAO = generateBuffer(trophy);
-    unsigned int trophySimpleVAO = generateBuffer(trophySimple);
+SceneResources sceneResources() {
+    SceneResources resources;
+    resources.loadMesh    = loadNamedMesh;
+    resources.loadTexture = loadNamedTexture;
+    resources.meshName = [](int vao) {
+        auto it = gMeshNameByVao.find(vao);
+        return it != gMeshNameByVao.end() ? it->second : std::string();
+    };
+    resources.textureName = [](unsigned int textureID) {
+        auto it = gTextureNameById.find(textureID);
+        return it != gTextureNameById.end() ? it->second : std::string();
+    };
+    return resources;
+}
 
-    // Store the meshes in a map for easy access for ray tracing
-    gMeshByVao.insert({ballVAO, sphere});
-    gMeshByVao.insert({boxVAO, box});
-    gMeshByVao.insert({padVAO, pad});
-    gMeshByVao.insert({trophyVAO, trophy});
-    gMeshByVao.insert({trophySimpleVAO, trophySimple});
+void buildDefaultScene() {
+    // Create meshes
+    unsigned int padIndexCount, boxIndexCount, sphereIndexCount, trophyIndexCount, trophySimpleIndexCount;
+    int padVAO          = loadNamedMesh(padMeshName, padIndexCount);
+    int boxVAO          = loadNamedMesh(boxMeshName, boxIndexCount);
+    int ballVAO         = loadNamedMesh(sphereMeshName, sphereIndexCount);
+    int trophyVAO       = loadNamedMesh(trophyModelPath, trophyIndexCount);
+    int trophySimpleVAO = loadNamedMesh(trophySimpleModelPath, trophySimpleIndexCount);
 
     // Construct scene
     rootNode = createSceneNode();
@@ -278,19 +883,10 @@ void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
 
 
     // Prepare the box node
-    PNGImage diffuseImage = loadPNGFile("../res/textures/Brick03_col.png");
-    unsigned int diffuseTexID = createTexture(diffuseImage);
-
-    PNGImage normalMapImage = loadPNGFile("../res/textures/Brick03_nrm.png");
-    unsigned int normalMapTexID = createTexture(normalMapImage);
-
-    PNGImage roughnessMapImage = loadPNGFile("../res/textures/Brick03_rgh.png");
-    unsigned int roughnessMapTexID = createTexture(roughnessMapImage);
-
     boxNode->nodeType = NORMAL_MAPPED_GEOMETRY;
-    boxNode->textureID   = diffuseTexID;
-    boxNode->normalMapID = normalMapTexID;
-    boxNode->roughnessMapID = roughnessMapTexID;
+    boxNode->textureID      = loadNamedTexture("../res/textures/Brick03_col.png");
+    boxNode->normalMapID    = loadNamedTexture("../res/textures/Brick03_nrm.png");
+    boxNode->roughnessMapID = loadNamedTexture("../res/textures/Brick03_rgh.png");
 
 
     // Add the nodes to the scene
@@ -299,19 +895,19 @@ void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
     rootNode->children.push_back(ballNode);
 
     boxNode->vertexArrayObjectID  = boxVAO;
-    boxNode->VAOIndexCount        = box.indices.size();
+    boxNode->VAOIndexCount        = boxIndexCount;
 
     padNode->vertexArrayObjectID  = padVAO;
-    padNode->VAOIndexCount        = pad.indices.size();
+    padNode->VAOIndexCount        = padIndexCount;
 
     ballNode->vertexArrayObjectID = ballVAO;
-    ballNode->VAOIndexCount       = sphere.indices.size();
+    ballNode->VAOIndexCount       = sphereIndexCount;
 
     trophyNode->vertexArrayObjectID = trophyVAO;
-    trophyNode->VAOIndexCount       = trophy.indices.size();
+    trophyNode->VAOIndexCount       = trophyIndexCount;
 
     trophySimpleNode->vertexArrayObjectID = trophySimpleVAO;
-    trophySimpleNode->VAOIndexCount       = trophySimple.indices.size();
+    trophySimpleNode->VAOIndexCount       = trophySimpleIndexCount;
     trophySimpleNode->position = glm::vec3(-40, -50, -90);
     trophySimpleNode->scale = glm::vec3(0.35f, 0.35f, 0.35f);
 
@@ -319,21 +915,312 @@ void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
     addChild(rootNode, trophySimpleNode);
 
 
-    // Load the compute ray tracing shader
-    computeShader = new Gloom::Shader();
-    computeShader->attach("../res/shaders/raytracer.comp");
-    computeShader->link();
-    printf("Loaded compute shader, valid: %d\n", computeShader->isValid());
+    // Text overlay
+    unsigned int textIndexCount;
+    SceneNode* textNode = new SceneNode();
+    textNode->nodeType = GEOMETRY_2D;
+    textNode->vertexArrayObjectID = loadNamedMesh(textMeshPrefix + "Hello, World!", textIndexCount);
+    textNode->VAOIndexCount       = textIndexCount;
+    textNode->textureID           = loadNamedTexture("../res/textures/charmap.png");
+    textNode->position            = glm::vec3(windowWidth / 2, windowHeight / 2, 0); // Move it somewhere so it's not in the corner
 
+    addChild(rootNode, textNode);
+}
 
-    // Create output texture for ray tracing (using windowWidth and windowHeight)
-    glGenTextures(1, &rayTracedTexture);
-    glBindTexture(GL_TEXTURE_2D, rayTracedTexture);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, windowWidth, windowHeight);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Replaces the scene with the contents of a binary scene file, returns false (and leaves the scene alone) on failure
+bool loadScene(std::string const &filename) {
+    auto start = std::chrono::steady_clock::now();
+
+    LoadedScene scene;
+    if (!loadSceneFile(filename, sceneResources(), scene)) {
+        return false;
+    }
+
+    // The game logic drives these nodes, so a scene without them is not playable
+    if (!scene.nodeByRole[ROLE_BOX] || !scene.nodeByRole[ROLE_PAD] || !scene.nodeByRole[ROLE_BALL]) {
+        std::cerr << "Scene file " << filename << " is missing the box, pad or ball node" << std::endl;
+        deleteSceneNode(scene.root);
+        return false;
+    }
+
+    rootNode = scene.root;
+    boxNode  = scene.nodeByRole[ROLE_BOX];
+    padNode  = scene.nodeByRole[ROLE_PAD];
+    ballNode = scene.nodeByRole[ROLE_BALL];
+    stressSceneNode = scene.nodeByRole[ROLE_STRESS_ROOT];
+
+    // The trophy is optional, an empty node keeps the toggle working
+    trophySimpleNode = scene.nodeByRole[ROLE_TROPHY] ? scene.nodeByRole[ROLE_TROPHY] : createSceneNode();
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << fmt::format("Loaded scene file {} with {} nodes in {:.2f} ms", filename, scene.nodeCount, elapsedMs) << std::endl;
+    return true;
+}
+
+bool exportScene(std::string const &filename) {
+    std::unordered_map<const SceneNode*, SceneNodeRole> roles = {
+        {boxNode, ROLE_BOX},
+        {padNode, ROLE_PAD},
+        {ballNode, ROLE_BALL},
+        {trophySimpleNode, ROLE_TROPHY},
+        {stressSceneNode, ROLE_STRESS_ROOT},
+    };
+
+    if (!writeSceneFile(filename, rootNode, roles, sceneResources())) {
+        std::cerr << "Failed to export the scene to " << filename << std::endl;
+        return false;
+    }
+
+    std::cout << fmt::format("Exported scene with {} SceneNodes to {}", totalChildren(rootNode) + 1, filename) << std::endl;
+    return true;
+}
+
+bool exportBeatMap(std::string const &filename) {
+    if (!beatTimeline.writeFile(filename)) {
+        std::cerr << "Failed to export the beat map to " << filename << std::endl;
+        return false;
+    }
+
+    std::cout << fmt::format("Exported beat map with {} key frames to {}", beatTimeline.size(), filename) << std::endl;
+    return true;
+}
+
+
+// Times the gather of the full trophy model, the largest mesh the ray tracer is likely to see
+void reportTrophyGatherTime() {
+    unsigned int indexCount;
+    int vao = loadNamedMesh(trophyModelPath, indexCount);
+    auto it = gMeshByVao.find(vao);
+    if (it == gMeshByVao.end() || triangleCount(it->second) == 0) {
+        return;
+    }
+
+    GatherJob job;
+    job.mesh          = &it->second;
+    job.modelMatrix   = glm::mat4(1.0f);
+    job.normalMatrix  = glm::mat3(1.0f);
+    job.materialID    = 0;
+    job.firstTriangle = 0;
+    std::vector<GatherJob> jobs = { job };
+    std::vector<Triangle> triangles(triangleCount(it->second));
+
+    ThreadPool singleThread(0);
+    auto timeGather = [&](ThreadPool& pool) {
+        auto start = std::chrono::steady_clock::now();
+        transformTriangles(jobs, triangles.data(), pool);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    timeGather(*gatherPool); // Warm up the caches
+    double singleMs = timeGather(singleThread);
+    double pooledMs = timeGather(*gatherPool);
+
+    std::cout << fmt::format("Full trophy gather: {} triangles in {:.2f} ms on {} threads ({:.2f} ms on one thread)",
+                             triangles.size(), pooledMs, gatherPool->threadCount(), singleMs) << std::endl;
+}
+
+void simulateFrame();
+void tuneRayTracer();
+
+void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
+    options = gameOptions;
+
+    bool knownFormat = false;
+    for (RayTracingOutputFormat const& format : rayTracingOutputFormats) {
+        if (options.rayTracingFormat == format.name) {
+            rayTracingOutputFormat = format;
+            knownFormat = true;
+        }
+    }
+    if (!knownFormat) {
+        std::cerr << "Unknown ray tracing output format \"" << options.rayTracingFormat << "\", using " << rayTracingOutputFormat.name << std::endl;
+    }
+
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+    glfwSetCursorPosCallback(window, mouseCallback);
+
+    // Start all programs up front, so that the driver can compile them in parallel while the scene loads
+    auto shaderStart = std::chrono::steady_clock::now();
+
+    sceneShaders = new ShaderVariants({"../res/shaders/simple.vert", "../res/shaders/simple.frag"});
+    for (bool clustered : {false, true}) {
+        sceneShaders->prepare(sceneVariant(false, clustered));
+        sceneShaders->prepare(sceneVariant(true, clustered));
+    }
+    sceneShaders->prepare(sceneVariant(false, false, GBUFFER_PASS));
+    sceneShaders->prepare(sceneVariant(true, false, GBUFFER_PASS));
+
+    // The deferred lighting pass is drawn as a full-screen quad
+    deferredLightingShaders = new ShaderVariants({"../res/shaders/2Dtext.vert", "../res/shaders/simple.frag"});
+    for (bool clustered : {false, true}) {
+        deferredLightingShaders->prepare(sceneVariant(false, clustered, LIGHTING_PASS));
+    }
+
+    if (loadTunedLayout(rayTracerLayout)) {
+        std::cout << "Using tuned ray tracer layout " << describeLayout(rayTracerLayout) << std::endl;
+    }
+    rayTracerShaders = new ShaderVariants({"../res/shaders/raytracer.comp"});
+    dynamicResolutionEnabled = options.dynamicResolution;
+    lightSamplesPerHit = int(options.lightSamples);
+    RayTracerFeatures firstFeatures = rayTracerFeatures(currentFrameSettings(), rayTracingBounces);
+    std::vector<Gloom::ShaderDefines> firstPrograms = rayTracerPrograms(firstFeatures, wavefrontEnabled);
+    for (Gloom::ShaderDefines const& program : firstPrograms) {
+        rayTracerShaders->prepare(program);
+    }
+
+    shader2D = new Gloom::Shader();
+    shader2D->startBasicShader("../res/shaders/2Dtext.vert", "../res/shaders/2Dtext.frag");
+
+    upscaleShader = new Gloom::Shader();
+    upscaleShader->startBasicShader("../res/shaders/2Dtext.vert", "../res/shaders/upscale.frag");
+
+    gbufferShader = new Gloom::Shader();
+    gbufferShader->startBasicShader("../res/shaders/simple.vert", "../res/shaders/gbuffer.frag");
+
+    depthPrepassShader = new Gloom::Shader();
+    depthPrepassShader->startBasicShader("../res/shaders/depth.vert", "../res/shaders/depth.frag");
+
+    // The normal mapped variants always read their maps from the same texture units
+    const Gloom::ShaderDefines normalMappedVariants[] = {
+        sceneVariant(true, false), sceneVariant(true, true), sceneVariant(true, false, GBUFFER_PASS)
+    };
+    for (Gloom::ShaderDefines const& defines : normalMappedVariants) {
+        Gloom::Shader* normalMappedShader = sceneShaders->get(defines);
+        normalMappedShader->activate();
+        glUniform1i(normalMappedShader->getUniformFromName("diffuseMap"), 0);
+        glUniform1i(normalMappedShader->getUniformFromName("normalMap"), 1);
+        glUniform1i(normalMappedShader->getUniformFromName("roughnessMap"), 2);
+        normalMappedShader->deactivate();
+    }
+
+    // And the deferred lighting pass reads the G-buffer from the first three
+    for (bool clustered : {false, true}) {
+        Gloom::Shader* lightingShader = deferredLightingShaders->get(sceneVariant(false, clustered, LIGHTING_PASS));
+        lightingShader->activate();
+        glUniform1i(lightingShader->getUniformFromName("gbufferDepth"), 0);
+        glUniform1i(lightingShader->getUniformFromName("gbufferNormal"), 1);
+        glUniform1i(lightingShader->getUniformFromName("gbufferAlbedo"), 2);
+        lightingShader->deactivate();
+    }
+
+    // Build the scene, either from a scene file or the built-in one
+    if (options.scenePath.empty() || !loadScene(options.scenePath)) {
+        buildDefaultScene();
+    }
+
+    // Swap in another beat map, the built-in one stays if it can't be loaded
+    if (!options.beatMapPath.empty() && beatTimeline.loadFile(options.beatMapPath)) {
+        std::cout << fmt::format("Loaded beat map {} with {} key frames", options.beatMapPath, beatTimeline.size()) << std::endl;
+    }
+
+
+    // Prepare the stress scene, it stays empty unless requested on the command line
+    stressMeshes.trophy = loadStressMesh(trophySimpleModelPath);
+    stressMeshes.sphere = loadStressMesh(sphereMeshName);
+    stressMeshes.cube   = loadStressMesh(cubeMeshName);
+
+    if (!stressSceneNode) {
+        stressSceneNode = createSceneNode();
+        stressSceneNode->position = boxPosition;
+        addChild(rootNode, stressSceneNode);
+    }
+
+    if (options.stressObjects > 0 || options.stressLights > 0) {
+        setStressScene(options.stressObjects, options.stressLights, options.stressSeed);
+    }
+
+    // hardware_concurrency() may return 0 when it can't tell
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    gatherPool = new ThreadPool(hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+
+
+    // The compute ray tracing shader has had the scene load to compile in
+    bool rayTracerValid = true;
+    for (Gloom::ShaderDefines const& program : firstPrograms) {
+        rayTracerValid = rayTracerShaders->get(program)->isValid() && rayTracerValid;
+    }
+    printf("Loaded compute shader, valid: %d\n", rayTracerValid);
+
+    initOcclusionCulling(windowWidth, windowHeight);
+    initGpuTransform();
+    initTriangleBinning();
+    initLightClustering();
+    initFrameRing(frameRingInitialBytes);
+
+    double frameBudgetMs = 1000.0 / std::max(options.targetFps, 1u);
+    dynamicResolution = new DynamicResolution(frameBudgetMs * rayTracingFrameShare, maxRayTracingBounces);
+    rayTracingTimer = new GpuTimer();
+
+
+    // Create the output textures for ray tracing (using windowWidth and windowHeight)
+    glGenTextures(2, rayTracedTextures);
+    glGenTextures(2, rayDistanceTextures);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, rayTracedTextures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, rayTracingOutputFormat.internalFormat, windowWidth, windowHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // Only ever read with texelFetch
+        glBindTexture(GL_TEXTURE_2D, rayDistanceTextures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, windowWidth, windowHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The G-buffer of the hybrid renderer, as large as the ray tracer output and only ever read with texelFetch
+    glGenTextures(1, &gbufferDepthTexture);
+    glGenTextures(1, &gbufferNormalTexture);
+    glGenTextures(1, &gbufferMaterialTexture);
+    const GLenum gbufferFormats[] = { GL_DEPTH_COMPONENT32F, GL_RGB10_A2, GL_R16UI };
+    const unsigned int gbufferTextures[] = { gbufferDepthTexture, gbufferNormalTexture, gbufferMaterialTexture };
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, gbufferTextures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, gbufferFormats[i], windowWidth, windowHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    glGenFramebuffers(1, &gbufferFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gbufferDepthTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gbufferNormalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gbufferMaterialTexture, 0);
+    const GLenum gbufferAttachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, gbufferAttachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "The G-buffer framebuffer is incomplete, hybrid rendering will not work" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The G-buffer of deferred shading, 4 bytes a target: depth, octahedral normal, and albedo with roughness in alpha.
+    // It has a single sample, so deferred shading loses the MSAA of the default framebuffer the forward path draws to.
+    glGenTextures(1, &deferredDepthTexture);
+    glGenTextures(1, &deferredNormalTexture);
+    glGenTextures(1, &deferredAlbedoTexture);
+    const GLenum deferredFormats[] = { GL_DEPTH_COMPONENT32F, GL_RG16F, GL_RGBA8 };
+    const unsigned int deferredTextures[] = { deferredDepthTexture, deferredNormalTexture, deferredAlbedoTexture };
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, deferredTextures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, deferredFormats[i], windowWidth, windowHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &deferredFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, deferredFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, deferredDepthTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, deferredNormalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, deferredAlbedoTexture, 0);
+    glDrawBuffers(2, gbufferAttachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "The deferred G-buffer framebuffer is incomplete, deferred shading will not work" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
     // Create a full-screen quad for displaying the computed image
     float quadVertices[] = {
         // positions                             // texCoords
@@ -364,107 +1251,191 @@ void initGame(GLFWwindow* window, CommandLineOptions gameOptions) {
     glBindVertexArray(0);
 
 
-    shader2D = new Gloom::Shader();
-    shader2D->makeBasicShader("../res/shaders/2Dtext.vert", "../res/shaders/2Dtext.frag");
+    shader2D->finishLink();
+    upscaleShader->finishLink();
+    gbufferShader->finishLink();
+    double shaderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+    std::cout << fmt::format("Shader programs ready {:.2f} ms after starting to compile them", shaderMs) << std::endl;
 
-    PNGImage charmapImage = loadPNGFile("../res/textures/charmap.png");
-    printf("Loaded charmap with dimensions %d x %d\n", charmapImage.width, charmapImage.height);
-    unsigned int charmapTexID = createTexture(charmapImage);
 
-    std::string text = "Hello, World!";
-    float ratio = 39.0f / 29.0f;  // height / width
-    float totalWidth = 200.0f;    // good enough for this text?
-    Mesh textMesh = generateTextGeometryBuffer(text, ratio, totalWidth);
+    // Setup the camera callback
+    glfwSetKeyCallback(window, keyCallback);
 
-    unsigned int textVAO = generateBuffer(textMesh);
+    getTimeDeltaSeconds();
+    previousGameState = currentGameState();
 
-    printf("Generated text mesh with texture id %d and VAO id %d\n", charmapTexID, textVAO);
+    // Simulate the first frame right away, so that there is always a finished frame to render
+    simulationThread = new WorkerThread();
+    simulateFrame();
+    std::swap(renderedFrame, simulatedFrame);
 
-    SceneNode* textNode = new SceneNode();
-    textNode->nodeType = GEOMETRY_2D;
-    textNode->vertexArrayObjectID = textVAO;
-    textNode->VAOIndexCount       = textMesh.indices.size();
-    textNode->textureID           = charmapTexID;
-    textNode->position            = glm::vec3(windowWidth / 2, windowHeight / 2, 0); // Move it somewhere so it's not in the corner
+    if (options.tuneRayTracer) {
+        tuneRayTracer();
+    }
 
-    addChild(rootNode, textNode);
+    std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
 
+    std::cout << "Ready. Click to start!" << std::endl;
+}
 
-    // Setup the camera callback
-    glfwSetKeyCallback(window, keyCallback);
+void setStressScene(unsigned int objectCount, unsigned int lightCount, unsigned int seed) {
+    clearStressScene(stressSceneNode);
 
-    getTimeDeltaSeconds();
+    StressSceneParams params;
+    params.objectCount = objectCount;
+    params.lightCount  = lightCount;
+    params.seed        = seed;
+    populateStressScene(stressSceneNode, params, stressMeshes, boxDimensions / 2.0f);
 
-    std::cout << fmt::format("Initialized scene with {} SceneNodes.", totalChildren(rootNode)) << std::endl;
+    if (objectCount > 0 || lightCount > 0) {
+        std::cout << fmt::format("Stress scene: {} objects, {} lights (seed {})", objectCount, lightCount, seed) << std::endl;
+    }
+}
 
-    std::cout << "Ready. Click to start!" << std::endl;
+void setRayTracingEnabled(bool enabled) {
+    rtEnabled = enabled;
+}
+
+void setDeferredShadingEnabled(bool enabled) {
+    deferredShadingEnabled = enabled;
+}
+
+FrameStats getFrameStats() {
+    FrameStats stats;
+    stats.triangleCount = frameTriangleCount;
+    stats.uploadBytes   = frameUploadBytes;
+    stats.drawCount     = frameDrawCount;
+    stats.gatherMs      = frameGatherMs;
+    return stats;
 }
 
-// Recursively gather all triangles in the scene graph into a single vector of triangles for ray tracing
-void gatherTriangles(SceneNode* node, std::vector<Triangle>& output)
+bool isGeometryNode(SceneNode* node) {
+    return node->nodeType == GEOMETRY || node->nodeType == NORMAL_MAPPED_GEOMETRY;
+}
+
+bool isInsideViewFrustum(SceneNode* node) {
+    return !frustumCullingEnabled || intersectsFrustum(viewFrustum, node->worldBounds);
+}
+
+// Collects the bounds of all geometry inside the view frustum, and whether any of it reflects
+void collectVisibleBounds(SceneNode* node, AABB& visibleBounds, bool& anyReflective) {
+    if (isGeometryNode(node) && node->vertexArrayObjectID != -1 && intersectsFrustum(viewFrustum, node->worldBounds)) {
+        expandBounds(visibleBounds, node->worldBounds);
+
+        const Material& material = gMaterials[std::min<size_t>(node->materialID, gMaterials.size() - 1)];
+        if (material.reflectivity >= 0.001f) { // Same cutoff as traceRay() in raytracer.comp
+            anyReflective = true;
+        }
+    }
+
+    for (SceneNode* child : node->children) {
+        collectVisibleBounds(child, visibleBounds, anyReflective);
+    }
+}
+
+// Primary rays only hit geometry inside the frustum. Shadow rays run from those hits to a light, so they stay
+// inside the box around the visible geometry and the lights. Reflected rays are only traced with more than one
+// bounce, and can go anywhere.
+//
+// The box node bounds all of them whenever the visible geometry lies inside it: its faces point inwards and the ray
+// tracer skips back faces, so the camera sees in through the walls, but no ray starting inside can leave. Everything
+// outside the box is culled then, even when the visible surfaces reflect. The built-in scene (and the stress scene)
+// lies entirely inside the box, which is one node spanning all of it, so there nothing is culled; the culling pays
+// off for scene files with geometry around the box.
+void updateRayTracingRegion(int bounces) {
+    AABB visibleBounds;
+    bool anyReflective = false;
+    collectVisibleBounds(rootNode, visibleBounds, anyReflective);
+
+    AABB enclosure;
+    bool enclosed = boxNode != nullptr && boxNode->vertexArrayObjectID != -1
+        && containsBounds(boxNode->worldBounds, visibleBounds);
+    if (enclosed) {
+        enclosure = boxNode->worldBounds;
+    }
+
+    rtSecondaryRegion = visibleBounds;
+    for (const LightSourceData& light : lightsData) {
+        expandBounds(rtSecondaryRegion, light.position);
+    }
+
+    if (!frustumCullingEnabled) {
+        rtSecondaryRegionUnbounded = true;
+    }
+    else if (enclosed) {
+        // Shadow rays toward lights outside the box end at its walls as well
+        rtSecondaryRegionUnbounded = false;
+        rtSecondaryRegion = anyReflective && bounces > 1 ? enclosure : clipBounds(rtSecondaryRegion, enclosure);
+    }
+    else {
+        rtSecondaryRegionUnbounded = anyReflective && bounces > 1;
+    }
+}
+
+bool contributesToRayTracing(SceneNode* node) {
+    // The region contains everything inside the frustum, so this covers primary rays as well
+    return rtSecondaryRegionUnbounded || boundsOverlap(node->worldBounds, rtSecondaryRegion);
+}
+
+// Collects every mesh instance the ray tracer can see, assigning each its range of the output triangles
+void collectGatherJobs(SceneNode* node, std::vector<GatherJob>& jobs, size_t& totalTriangles)
 {
-    // If this node has real geometry:
-    if (node->nodeType == GEOMETRY || 
-        node->nodeType == NORMAL_MAPPED_GEOMETRY) 
+    // If this node has real geometry that the ray tracer can see:
+    if (isGeometryNode(node) && contributesToRayTracing(node))
     {
         // Get the mesh from the VAO ID
         auto it = gMeshByVao.find(node->vertexArrayObjectID);
-        if (it != gMeshByVao.end()) {
-            Mesh& mesh = it->second;
-
-            for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-                unsigned int i0 = mesh.indices[i + 0];
-                unsigned int i1 = mesh.indices[i + 1];
-                unsigned int i2 = mesh.indices[i + 2];
-
-                glm::vec3 p0_local = mesh.vertices[i0];
-                glm::vec3 p1_local = mesh.vertices[i1];
-                glm::vec3 p2_local = mesh.vertices[i2];
-
-                glm::vec3 p0_world = glm::vec3(node->modelMatrix * glm::vec4(p0_local, 1.0));
-                glm::vec3 p1_world = glm::vec3(node->modelMatrix * glm::vec4(p1_local, 1.0));
-                glm::vec3 p2_world = glm::vec3(node->modelMatrix * glm::vec4(p2_local, 1.0));
-
-                glm::vec3 n0_world(0.0f);
-                glm::vec3 n1_world(0.0f);
-                glm::vec3 n2_world(0.0f);
-
-                if (!mesh.normals.empty()) {
-                    glm::vec3 n0_local = mesh.normals[i0];
-                    glm::vec3 n1_local = mesh.normals[i1];
-                    glm::vec3 n2_local = mesh.normals[i2];
-
-                    // For correct normal transform, use node->normalMatrix
-                    n0_world = glm::normalize(node->normalMatrix * n0_local);
-                    n1_world = glm::normalize(node->normalMatrix * n1_local);
-                    n2_world = glm::normalize(node->normalMatrix * n2_local);
-                }
-
-                Triangle tri;
-                tri.v0 = p0_world;
-                tri.v1 = p1_world;
-                tri.v2 = p2_world;
-                tri.n0 = n0_world;
-                tri.n1 = n1_world;
-                tri.n2 = n2_world;
-                tri.materialID = node->materialID;
-
-                output.push_back(tri);
-            }
+        if (it != gMeshByVao.end() && triangleCount(it->second) > 0) {
+            GatherJob job;
+            job.mesh          = &it->second;
+            job.modelMatrix   = node->modelMatrix;
+            job.normalMatrix  = node->normalMatrix;
+            job.materialID    = node->materialID;
+            job.firstTriangle = totalTriangles;
+            jobs.push_back(job);
+
+            totalTriangles += triangleCount(it->second);
         }
     }
 
-    // Recursively gather from children
     for (SceneNode* child : node->children) {
-        gatherTriangles(child, output);
+        collectGatherJobs(child, jobs, totalTriangles);
     }
 }
 
-void updateFrame(GLFWwindow* window) {
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+// Records every node the GL thread has to draw this frame
+void collectDrawItems(SceneNode* node, FrameSnapshot& frame) {
+    if (isGeometryNode(node) && node->vertexArrayObjectID != -1 && isInsideViewFrustum(node)) {
+        DrawItem item;
+        item.modelViewProjection = node->currentTransformationMatrix;
+        item.modelMatrix         = node->modelMatrix;
+        item.normalMatrix        = node->normalMatrix;
+        item.nodeType            = node->nodeType;
+        item.vertexArrayObjectID = node->vertexArrayObjectID;
+        item.indexCount          = node->VAOIndexCount;
+        item.textureID           = node->textureID;
+        item.normalMapID         = node->normalMapID;
+        item.roughnessMapID      = node->roughnessMapID;
+        item.materialID          = node->materialID;
+        item.worldBounds         = node->worldBounds;
+        frame.drawList.push_back(item);
+    }
+    else if (node->nodeType == GEOMETRY_2D) {
+        DrawItem2D item;
+        item.modelMatrix         = node->modelMatrix;
+        item.vertexArrayObjectID = node->vertexArrayObjectID;
+        item.indexCount          = node->VAOIndexCount;
+        item.textureID           = node->textureID;
+        frame.drawList2D.push_back(item);
+    }
 
-    double timeDelta = getTimeDeltaSeconds();
+    for (SceneNode* child : node->children) {
+        collectDrawItems(child, frame);
+    }
+}
 
+// Advances ball, key frames and game state by one fixed time step
+void stepGame(double timeStep) {
     const float ballBottomY = boxNode->position.y - (boxDimensions.y/2) + ballRadius + padDimensions.y;
     const float ballTopY    = boxNode->position.y + (boxDimensions.y/2) - ballRadius;
     const float BallVerticalTravelDistance = ballTopY - ballBottomY;
@@ -476,26 +1447,6 @@ void updateFrame(GLFWwindow* window) {
     const float ballMinZ = boxNode->position.z - (boxDimensions.z/2) + ballRadius;
     const float ballMaxZ = boxNode->position.z + (boxDimensions.z/2) - ballRadius - cameraWallOffset;
 
-    if (freeCameraActive) {
-        // Let the camera update its position/orientation based on keys pressed
-        freeCam->updateCamera((float)timeDelta);
-    }
-
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1)) {
-        mouseLeftPressed = true;
-        mouseLeftReleased = false;
-    } else {
-        mouseLeftReleased = mouseLeftPressed;
-        mouseLeftPressed = false;
-    }
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2)) {
-        mouseRightPressed = true;
-        mouseRightReleased = false;
-    } else {
-        mouseRightReleased = mouseRightPressed;
-        mouseRightPressed = false;
-    }
-
     if (!hasStarted) {
         if (mouseLeftPressed) {
             totalElapsedTime = 0;
@@ -507,12 +1458,12 @@ void updateFrame(GLFWwindow* window) {
         ballPosition.y = ballBottomY;
         ballPosition.z = ballMinZ + (1 - padPositionZ) * ((ballMaxZ+cameraWallOffset) - ballMinZ);
     } else {
-        totalElapsedTime += timeDelta;
+        totalElapsedTime += timeStep;
         if (hasLost) {
             if (mouseLeftReleased) {
                 hasLost = false;
                 hasStarted = false;
-                currentKeyFrame = 0;
+                beatTimeline.rewind();
                 previousKeyFrame = 0;
             }
         } else if (isPaused) {
@@ -520,32 +1471,22 @@ void updateFrame(GLFWwindow* window) {
                 isPaused = false;
             }
         } else {
-            gameElapsedTime += timeDelta;
+            gameElapsedTime += timeStep;
             if (mouseRightReleased) {
                 isPaused = true;
             }
             // Get the timing for the beat of the song
-            for (unsigned int i = currentKeyFrame; i < keyFrameTimeStamps.size(); i++) {
-                if (gameElapsedTime < keyFrameTimeStamps.at(i)) {
-                    continue;
-                }
-                currentKeyFrame = i;
-            }
-
-            jumpedToNextFrame = currentKeyFrame != previousKeyFrame;
-            previousKeyFrame = currentKeyFrame;
+            BeatSegment beat = beatTimeline.advance(gameElapsedTime);
 
-            double frameStart = keyFrameTimeStamps.at(currentKeyFrame);
-            double frameEnd = keyFrameTimeStamps.at(currentKeyFrame + 1); // Assumes last keyframe at infinity
+            jumpedToNextFrame = beat.index != previousKeyFrame;
+            previousKeyFrame = beat.index;
 
-            double elapsedTimeInFrame = gameElapsedTime - frameStart;
-            double frameDuration = frameEnd - frameStart;
-            double fractionFrameComplete = elapsedTimeInFrame / frameDuration;
+            double fractionFrameComplete = beat.fraction;
 
             double ballYCoord;
 
-            KeyFrameAction currentOrigin = keyFrameDirections.at(currentKeyFrame);
-            KeyFrameAction currentDestination = keyFrameDirections.at(currentKeyFrame + 1);
+            KeyFrameAction currentOrigin = beat.origin;
+            KeyFrameAction currentDestination = beat.destination;
 
             // Synchronize ball with music
             if (currentOrigin == BOTTOM && currentDestination == BOTTOM) {
@@ -560,9 +1501,9 @@ void updateFrame(GLFWwindow* window) {
 
             // Make ball move
             const float ballSpeed = 60.0f;
-            ballPosition.x += timeDelta * ballSpeed * ballDirection.x;
+            ballPosition.x += timeStep * ballSpeed * ballDirection.x;
             ballPosition.y = ballYCoord;
-            ballPosition.z += timeDelta * ballSpeed * ballDirection.z;
+            ballPosition.z += timeStep * ballSpeed * ballDirection.z;
 
             // Make ball bounce
             if (ballPosition.x < ballMinX) {
@@ -604,6 +1545,62 @@ void updateFrame(GLFWwindow* window) {
         }
     }
 
+    // Each release is only acted on once
+    mouseLeftReleased  = false;
+    mouseRightReleased = false;
+}
+
+// Advances the game by one frame and fills `simulatedFrame` with what to draw.
+// Runs on the simulation thread, so there must be no GL or GLFW calls in here.
+void simulateFrame() {
+    FrameSnapshot& frame = *simulatedFrame;
+
+    for (KeyEvent const& event : simulationInput.keyEvents) {
+        applyKeyEvent(event.key, event.action);
+    }
+
+    padPositionX = glm::clamp(padPositionX + simulationInput.padDeltaX, 0.0, 1.0);
+    padPositionZ = glm::clamp(padPositionZ + simulationInput.padDeltaZ, 0.0, 1.0);
+
+    double timeDelta = getTimeDeltaSeconds();
+
+    if (freeCameraActive) {
+        // Let the camera update its position/orientation based on keys pressed
+        freeCam->updateCamera((float)timeDelta);
+    }
+
+    // Releases are remembered until a game step has seen them, so that a click can't fall between two steps
+    if (simulationInput.mouseLeft) {
+        mouseLeftPressed = true;
+    } else {
+        mouseLeftReleased = mouseLeftReleased || mouseLeftPressed;
+        mouseLeftPressed = false;
+    }
+    if (simulationInput.mouseRight) {
+        mouseRightPressed = true;
+    } else {
+        mouseRightReleased = mouseRightReleased || mouseRightPressed;
+        mouseRightPressed = false;
+    }
+
+    // The pad follows the mouse directly unless autoplay moves it, so only then is it interpolated
+    if (!options.enableAutoplay) {
+        previousGameState.padPositionX = padPositionX;
+        previousGameState.padPositionZ = padPositionZ;
+    }
+
+    // Advance the game in fixed steps, whatever the frame rate. Time beyond maxGameStepsPerFrame steps is dropped,
+    // so that a slow frame slows the game down instead of making the next frame even slower.
+    gameTimeAccumulator = std::min(gameTimeAccumulator + timeDelta, maxGameStepsPerFrame * gameTimeStep);
+    while (gameTimeAccumulator >= gameTimeStep) {
+        previousGameState = currentGameState();
+        stepGame(gameTimeStep);
+        gameTimeAccumulator -= gameTimeStep;
+    }
+
+    // Show the game between the last two steps, at the point in time the frame is actually at
+    GameState shown = interpolateGameState(previousGameState, currentGameState(), gameTimeAccumulator / gameTimeStep);
+
     glm::mat4 projection = glm::perspective(glm::radians(80.0f), float(windowWidth) / float(windowHeight), 0.1f, 350.f);
 
     glm::mat4 view;
@@ -613,9 +1610,9 @@ void updateFrame(GLFWwindow* window) {
     else {
         // Original fixed camera transform
         glm::vec3 cameraPosition = glm::vec3(initialCameraPosition);
-        float lookRotation = -0.6f / (1.f + exp(-5.f * (padPositionX - 0.5f))) + 0.3f;
+        float lookRotation = -0.6f / (1.f + exp(-5.f * (shown.padPositionX - 0.5f))) + 0.3f;
         glm::mat4 cameraTransform =
-              glm::rotate(0.3f + 0.2f * float(-padPositionZ*padPositionZ), glm::vec3(1, 0, 0))
+              glm::rotate(0.3f + 0.2f * float(-shown.padPositionZ*shown.padPositionZ), glm::vec3(1, 0, 0))
             * glm::rotate(lookRotation, glm::vec3(0, 1, 0))
             * glm::translate(-cameraPosition);
 
@@ -628,35 +1625,72 @@ void updateFrame(GLFWwindow* window) {
     glm::mat4 invView = glm::inverse(view);
     glm::vec3 cameraPos = glm::vec3(invView[3]); // Extract translation component
 
-    // Upload camera position to the shader
-    glUniform3fv(glGetUniformLocation(shader->get(), "cameraPosition"), 1, glm::value_ptr(cameraPos));
-
     // Move and rotate various SceneNodes
-    boxNode->position = { 0, -10, -80 };
+    boxNode->position = boxPosition;
 
-    ballNode->position = ballPosition;
+    ballNode->position = shown.ballPosition;
     ballNode->scale = glm::vec3(ballRadius);
-    ballNode->rotation = { 0, totalElapsedTime*2, 0 };
-
-    // Upload the ball's position to the shader
-    GLint loc = glGetUniformLocation(shader->get(), "ballCenter");
-    glUniform3fv(loc, 1, glm::value_ptr(ballPosition));
+    ballNode->rotation = { 0, shown.totalElapsedTime*2, 0 };
 
     padNode->position  = {
-        boxNode->position.x - (boxDimensions.x/2) + (padDimensions.x/2) + (1 - padPositionX) * (boxDimensions.x - padDimensions.x),
+        boxNode->position.x - (boxDimensions.x/2) + (padDimensions.x/2) + (1 - shown.padPositionX) * (boxDimensions.x - padDimensions.x),
         boxNode->position.y - (boxDimensions.y/2) + (padDimensions.y/2),
-        boxNode->position.z - (boxDimensions.z/2) + (padDimensions.z/2) + (1 - padPositionZ) * (boxDimensions.z - padDimensions.z)
+        boxNode->position.z - (boxDimensions.z/2) + (padDimensions.z/2) + (1 - shown.padPositionZ) * (boxDimensions.z - padDimensions.z)
     };
 
     // Clear old contents so we can gather fresh positions
     lightsData.clear();
 
     // Recompute transformations
+    viewFrustum = extractFrustum(VP);
     updateNodeTransformations(rootNode, glm::mat4(1.0f), VP);
+    updateRayTracingRegion(rayTracingBounces);
+
+    // Hand everything over in the snapshot
+    frame.settings = currentFrameSettings();
+
+    frame.view           = view;
+    frame.projection     = projection;
+    frame.viewProjection = VP;
+    frame.cameraPosition = cameraPos;
+    frame.ballPosition   = shown.ballPosition;
+    frame.boxBounds      = boxNode != nullptr ? boxNode->worldBounds : AABB();
+    frame.lights.swap(lightsData);
+
+    frame.drawList.clear();
+    frame.drawList2D.clear();
+    collectDrawItems(rootNode, frame);
+
+    // The output is sized up front from the prefix sum of the triangle counts, so the transforms write it in place
+    auto gatherStart = std::chrono::steady_clock::now();
+    frame.gatherJobs.clear();
+    frame.triangleCount = 0;
+    collectGatherJobs(rootNode, frame.gatherJobs, frame.triangleCount);
+
+    // The GPU path transforms the same jobs right before tracing
+    if (rtEnabled && !gpuTransformEnabled) {
+        // Keeps its capacity between frames, so this only initializes memory when the scene grows
+        frame.triangles.resize(frame.triangleCount);
+        transformTriangles(frame.gatherJobs, frame.triangles.data(), *gatherPool);
+    }
+    frame.gatherMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gatherStart).count();
+}
+
+// Starts simulating the next frame on the simulation thread, with the input that came in since the last one
+void updateFrame(GLFWwindow* window) {
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    allTriangles.clear();
-    gatherTriangles(rootNode, allTriangles);
+    pendingInput.mouseLeft  = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) == GLFW_PRESS;
+    pendingInput.mouseRight = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2) == GLFW_PRESS;
+    simulationInput = std::move(pendingInput);
+    pendingInput = FrameInput();
 
+    simulationThread->start(simulateFrame);
+}
+
+void finishFrameUpdate() {
+    simulationThread->wait();
+    std::swap(renderedFrame, simulatedFrame);
 }
 
 void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar, glm::mat4 VP) {
@@ -681,6 +1715,22 @@ void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar,
     // Then compute the final MVP by multiplying your VP by the node's model matrix
     node->currentTransformationMatrix = VP * node->modelMatrix;
 
+    // Keep the world space bounds of geometry up to date for culling
+    if (isGeometryNode(node) && node->vertexArrayObjectID != -1) {
+        if (!node->hasLocalBounds) {
+            auto it = gMeshByVao.find(node->vertexArrayObjectID);
+            if (it != gMeshByVao.end()) {
+                node->localBounds = it->second.bounds;
+            } else {
+                // Unknown mesh, never cull it
+                node->localBounds.min = glm::vec3(-1e30f);
+                node->localBounds.max = glm::vec3( 1e30f);
+            }
+            node->hasLocalBounds = true;
+        }
+        node->worldBounds = transformBounds(node->localBounds, node->modelMatrix);
+    }
+
     // If point light, store info
     if (node->nodeType == POINT_LIGHT) {
         glm::vec3 worldPos = glm::vec3(node->modelMatrix * glm::vec4(0,0,0,1));
@@ -705,240 +1755,609 @@ void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar,
     }
 }
 
-void renderNode3D(SceneNode* node) {
-    glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(node->currentTransformationMatrix));
+// Fills the input of the occlusion culling pass, draw item i gets slot i of the indirect command buffer
+void collectOcclusionInstances(std::vector<DrawItem> const& drawList) {
+    occlusionInstances.clear();
+
+    for (DrawItem const& item : drawList) {
+        OcclusionInstance instance;
+        instance.boundsMin  = glm::vec4(item.worldBounds.min, 0.0f);
+        instance.boundsMax  = glm::vec4(item.worldBounds.max, 0.0f);
+        instance.indexCount = item.indexCount;
+        instance.pad0 = instance.pad1 = instance.pad2 = 0;
+        occlusionInstances.push_back(instance);
+    }
+}
+
+// A vertex array that only feeds the positions of `vertexArray`, sharing its position and index buffers
+unsigned int positionOnlyVertexArray(int vertexArray) {
+    auto found = positionOnlyVertexArrays.find(vertexArray);
+    if (found != positionOnlyVertexArrays.end()) {
+        return found->second;
+    }
+
+    GLint positionBuffer, indexBuffer;
+    glBindVertexArray(vertexArray);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &positionBuffer);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &indexBuffer);
+
+    unsigned int positionsOnly;
+    glGenVertexArrays(1, &positionsOnly);
+    glBindVertexArray(positionsOnly);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindVertexArray(0);
+
+    positionOnlyVertexArrays[vertexArray] = positionsOnly;
+    return positionsOnly;
+}
+
+// Draws the geometry of one node, only feeding its positions if `positionsOnly` is set
+void drawItemGeometry(DrawItem const& item, int occlusionSlot, bool positionsOnly = false) {
+    glBindVertexArray(positionsOnly ? positionOnlyVertexArray(item.vertexArrayObjectID) : item.vertexArrayObjectID);
+
+    if (occlusionSlot >= 0) {
+        // The culling pass has set the instance count to 0 if the node is occluded
+        const void* commandOffset = (const void*)(occlusionSlot * sizeof(DrawElementsIndirectCommand));
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commandOffset);
+    } else {
+        glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, nullptr);
+    }
+    frameDrawCount++;
+}
+
+// Draws one node of the draw list, `occlusionSlot` is -1 when occlusion culling is off
+void renderDrawItem(DrawItem const& item, int occlusionSlot) {
+    glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(item.modelViewProjection));
 
     // Upload the Model to uniform location = 4
-    glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(node->modelMatrix));
+    glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
 
     // Upload the Normal matrix to uniform location = 5, using glUniformMatrix3fv since it's a mat3
-    glUniformMatrix3fv(5, 1, GL_FALSE, glm::value_ptr(node->normalMatrix));
+    glUniformMatrix3fv(5, 1, GL_FALSE, glm::value_ptr(item.normalMatrix));
+    frameUploadBytes += 2 * sizeof(glm::mat4) + sizeof(glm::mat3);
 
-    switch(node->nodeType) {
+    switch(item.nodeType) {
         case NORMAL_MAPPED_GEOMETRY:
-            // Enable normal mapping
-            glUniform1i(glGetUniformLocation(shader->get(), "useNormalMap"), 1);
-    
             // Bind the diffuse map to texture unit 0
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, node->textureID);
-            glUniform1i(glGetUniformLocation(shader->get(), "diffuseMap"), 0);
-    
+            glBindTexture(GL_TEXTURE_2D, item.textureID);
+
             // Bind the normal map to texture unit 1
             glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, node->normalMapID);
-            glUniform1i(glGetUniformLocation(shader->get(), "normalMap"), 1);
+            glBindTexture(GL_TEXTURE_2D, item.normalMapID);
 
             // Bind the roughness map to texture unit 2
             glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, node->roughnessMapID);
-            glUniform1i(glGetUniformLocation(shader->get(), "roughnessMap"), 2);
-            
+            glBindTexture(GL_TEXTURE_2D, item.roughnessMapID);
+
             // Then draw
-            if (node->vertexArrayObjectID != -1) {
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
-            }
-        
+            drawItemGeometry(item, occlusionSlot);
             break;
         case GEOMETRY:
-            glUniform1i(glGetUniformLocation(shader->get(), "useNormalMap"), 0);
-
-            if(node->vertexArrayObjectID != -1) {
-                glBindVertexArray(node->vertexArrayObjectID);
-                glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
-            }
+            drawItemGeometry(item, occlusionSlot);
             break;
-        case POINT_LIGHT: break;
-        case SPOT_LIGHT: break;
+        default: break;
     }
+}
 
-    for (SceneNode* child : node->children) {
-        renderNode3D(child);
+void renderDrawItem2D(DrawItem2D const& item, glm::mat4 ortho) {
+    // Combine orthographic projection with node’s model transform
+    glm::mat4 MVP = ortho * item.modelMatrix;
+
+    // Then upload the MVP to the shader
+    GLint mvpLoc = glGetUniformLocation(shader2D->get(), "MVP");
+    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(MVP));
+
+    // Bind the texture to texture unit 0
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, item.textureID);
+
+    // Sampler in the fragment shader is named "textSampler", set it to 0 (the texture unit)
+    GLint samplerLoc = glGetUniformLocation(shader2D->get(), "textSampler");
+    glUniform1i(samplerLoc, 0);
+
+    // Draw geometry
+    glBindVertexArray(item.vertexArrayObjectID);
+    glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, nullptr);
+}
+
+// Writes this frame's lights and their radii into the Lights storage buffer, binding 0
+void uploadLightBuffer(std::vector<LightSourceData> const& lights) {
+    size_t size = sizeof(LightBufferHeader) + lights.size() * sizeof(ShaderLight);
+
+    // Written straight into the ring, through a staging copy only when the ring is full
+    std::vector<unsigned char> staging;
+    FrameAllocation allocation = allocateFrameData(GL_SHADER_STORAGE_BUFFER, size);
+    if (!allocation.data) {
+        staging.resize(size);
+    }
+    unsigned char* data = allocation.data ? static_cast<unsigned char*>(allocation.data) : staging.data();
+
+    LightBufferHeader header = { GLint(lights.size()), 0, 0, 0 };
+    std::memcpy(data, &header, sizeof(header));
+    ShaderLight* shaderLights = reinterpret_cast<ShaderLight*>(data + sizeof(LightBufferHeader));
+    for (size_t i = 0; i < lights.size(); i++) {
+        shaderLights[i].position = lights[i].position;
+        shaderLights[i].radius   = lightRadius(lights[i].color);
+        shaderLights[i].color    = lights[i].color;
+        shaderLights[i].pad0     = 0.0f;
     }
+
+    if (allocation.data) {
+        bindFrameData(GL_SHADER_STORAGE_BUFFER, 0, allocation);
+    } else {
+        uploadFrameData(GL_SHADER_STORAGE_BUFFER, 0, staging.data(), size);
+    }
+    frameUploadBytes += size;
 }
 
-void renderNode2D(SceneNode* node, glm::mat4 ortho) {
-    if (node->nodeType == GEOMETRY_2D) {
-        // Combine orthographic projection with node’s model transform
-        glm::mat4 MVP = ortho * node->modelMatrix;
+// Uploads and binds everything the ray tracer reads for the given frame. `tracePhase` picks the pixels of every
+// 2x2 block that are traced, the others are reprojected from the history texture; -1 traces all of them.
+// `reservoirHistory` tells the ray tracer whether the light reservoirs bound by bindLightReservoirs() can be reused.
+void uploadRayTracerInputs(FrameSnapshot const& frame, int tracePhase, bool reservoirHistory = false) {
+    // Same camera as the raster path, free or fixed
+    glm::mat4 invView = glm::inverse(frame.view);
+    glm::mat4 invProjection = glm::inverse(frame.projection);
+
+    // Bind the output textures as image units 0 and 1 for write access, and last frame's output to texture units 0 and 1
+    int history = 1 - rayTracedTextureIndex;
+    glBindImageTexture(0, rayTracedTextures[rayTracedTextureIndex], 0, GL_FALSE, 0, GL_WRITE_ONLY, rayTracingOutputFormat.internalFormat);
+    glBindImageTexture(1, rayDistanceTextures[rayTracedTextureIndex], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, rayTracedTextures[history]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, rayDistanceTextures[history]);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Camera and lights go through the frame ring as uniform blocks
+    CameraBlock camera;
+    camera.invProjection  = invProjection;
+    camera.invView        = invView;
+    camera.cameraPosition = glm::vec4(frame.cameraPosition, 1.0f);
+    camera.ambientColor   = glm::vec4(0.1f, 0.1f, 0.1f, 0.0f);
+
+    // A bit larger than the ball, so that its soft edge is always traced too
+    float ballBoundsRadius = float(ballRadius) * 1.1f;
+    camera.viewProjection            = frame.viewProjection;
+    camera.previousViewProjection    = rayTracingHistory.viewProjection;
+    camera.previousInvViewProjection = glm::inverse(rayTracingHistory.viewProjection);
+    camera.previousCameraPosition    = glm::vec4(rayTracingHistory.cameraPosition, 1.0f);
+    camera.ballBounds                = glm::vec4(frame.ballPosition, ballBoundsRadius);
+    camera.previousBallBounds        = glm::vec4(rayTracingHistory.ballPosition, ballBoundsRadius);
+
+    // The ball can only shadow a point from lights whose reach touches it, the count goes first
+    std::vector<GLint> ballLights = {0};
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        float reach = lightRadius(frame.lights[i].color) + ballBoundsRadius;
+        if (glm::distance(frame.lights[i].position, frame.ballPosition) <= reach
+            || glm::distance(frame.lights[i].position, rayTracingHistory.ballPosition) <= reach) {
+            ballLights.push_back(GLint(i));
+        }
+    }
+    ballLights[0] = GLint(ballLights.size() - 1);
+    uploadFrameData(GL_SHADER_STORAGE_BUFFER, 14, ballLights.data(), ballLights.size() * sizeof(GLint));
+    frameUploadBytes += ballLights.size() * sizeof(GLint);
+    float hasEnclosure = frame.boxBounds.isEmpty() ? 0.0f : 1.0f;
+    camera.enclosureMin              = glm::vec4(frame.boxBounds.min, hasEnclosure);
+    camera.enclosureMax              = glm::vec4(frame.boxBounds.max, hasEnclosure);
+    camera.tracePhase                = tracePhase;
+    camera.reservoirHistory          = reservoirHistory ? 1 : 0;
+    camera.pad0 = 0;
+
+    // Seeds the light sampling, so that every frame picks other lights
+    static GLuint frameSeed = 0;
+    camera.frameSeed = frameSeed++;
+    uploadFrameData(GL_UNIFORM_BUFFER, 1, &camera, sizeof(CameraBlock));
+    frameUploadBytes += sizeof(CameraBlock);
+
+    uploadLightBuffer(frame.lights);
+
+    if (frame.settings.gpuTransform) {
+        // Writes the triangles straight into the buffer the ray tracer reads
+        GLuint transformedTriangles = transformTrianglesOnGpu(frame.gatherJobs, frame.triangleCount, frameUploadBytes);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, transformedTriangles);
+    }
+    else {
+        // Transformed on the simulation thread
+        uploadFrameData(GL_SHADER_STORAGE_BUFFER, 1, frame.triangles.data(), frame.triangleCount * sizeof(Triangle));
+        frameUploadBytes += frame.triangleCount * sizeof(Triangle);
+    }
 
-        // Then upload the MVP to the shader
-        GLint mvpLoc = glGetUniformLocation(shader2D->get(), "MVP");
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, glm::value_ptr(MVP));
+    // Binding index = 2 must match `layout(std430, binding=2)` in compute
+    uploadFrameData(GL_SHADER_STORAGE_BUFFER, 2, gMaterials.data(), gMaterials.size() * sizeof(Material));
+    frameUploadBytes += gMaterials.size() * sizeof(Material);
+}
 
-        // Bind the texture to texture unit 0
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, node->textureID);
+// Swaps the light reservoir buffers and binds last frame's to binding 12 and this frame's to binding 13, for a frame
+// traced at `traceSize` with `samples` reservoirs per pixel. Returns whether last frame's reservoirs can be reused.
+bool bindLightReservoirs(FrameSnapshot const& frame, glm::ivec2 traceSize, int samples) {
+    LightReservoirHistory const& history = lightReservoirHistory;
+    bool historyValid = history.valid && rayTracingHistory.valid && history.traceSize == traceSize
+        && history.samples == samples && history.lightCount == frame.lights.size();
+
+    // Only written by the GPU, grows but never shrinks. Starts out as empty reservoirs (light -1, all weights 0),
+    // so that nothing reads undefined memory before the ray tracer has written every pixel.
+    size_t reservoirCount = size_t(traceSize.x) * size_t(traceSize.y) * size_t(samples);
+    if (reservoirCount > lightReservoirCapacity) {
+        if (lightReservoirCapacity == 0) {
+            glGenBuffers(2, lightReservoirBuffers);
+        }
+        const GLint emptyReservoir[4] = {-1, 0, 0, 0};
+        for (unsigned int buffer : lightReservoirBuffers) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, reservoirCount * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32I, GL_RGBA_INTEGER, GL_INT, emptyReservoir);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        lightReservoirCapacity = reservoirCount;
+        historyValid = false;
+    }
 
-        // Sampler in the fragment shader is named "textSampler", set it to 0 (the texture unit)
-        GLint samplerLoc = glGetUniformLocation(shader2D->get(), "textSampler");
-        glUniform1i(samplerLoc, 0);
+    lightReservoirIndex = 1 - lightReservoirIndex;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, lightReservoirBuffers[1 - lightReservoirIndex]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, lightReservoirBuffers[lightReservoirIndex]);
 
-        // Draw geometry
-        glBindVertexArray(node->vertexArrayObjectID);
-        glDrawElements(GL_TRIANGLES, node->VAOIndexCount, GL_UNSIGNED_INT, nullptr);
+    lightReservoirHistory.valid      = true;
+    lightReservoirHistory.traceSize  = traceSize;
+    lightReservoirHistory.samples    = samples;
+    lightReservoirHistory.lightCount = frame.lights.size();
+    return historyValid;
+}
+
+// Traces the bottom left `traceSize` part of the output texture with the given ray tracer variant,
+// whose work groups are laid out as `layout`
+void dispatchRayTracer(Gloom::Shader* rayTracerShader, RayTracerLayout const& layout, int triangleCount, glm::ivec2 traceSize) {
+    rayTracerShader->activate();
+    glUniform1i(rayTracerShader->getUniformFromName("numTriangles"), triangleCount);
+    glUniform2i(rayTracerShader->getUniformFromName("traceSize"), traceSize.x, traceSize.y);
+
+    GLuint workGroupsX = (traceSize.x + layout.localSizeX - 1) / layout.localSizeX;
+    GLuint workGroupsY = (traceSize.y + layout.localSizeY - 1) / layout.localSizeY;
+    glDispatchCompute(workGroupsX, workGroupsY, 1);
+}
+
+// Lays down the depth of the draw list with the position-only shader, without touching the color
+void renderDepthPrepass(FrameSnapshot const& frame) {
+    depthPrepassShader->activate();
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    for (size_t i = 0; i < frame.drawList.size(); i++) {
+        DrawItem const& item = frame.drawList[i];
+        if (item.nodeType == GEOMETRY || item.nodeType == NORMAL_MAPPED_GEOMETRY) {
+            glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(item.modelViewProjection));
+            frameUploadBytes += sizeof(glm::mat4);
+            drawItemGeometry(item, frame.settings.occlusionCulling ? int(i) : -1, true);
+        }
     }
 
-    // Recurse
-    for (SceneNode* child : node->children) {
-        renderNode2D(child, ortho);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    depthPrepassShader->deactivate();
+}
+
+// Shades the deferred G-buffer into the default framebuffer in one full-screen pass, which also writes the depth
+void renderDeferredLighting(FrameSnapshot const& frame, bool clustered, glm::ivec2 screenSize) {
+    Gloom::Shader* lighting = deferredLightingShaders->get(sceneVariant(false, clustered, LIGHTING_PASS));
+    lighting->activate();
+
+    glm::mat4 ortho = glm::ortho(0.0f, float(screenSize.x), 0.0f, float(screenSize.y), -1.0f, 1.0f);
+    glm::mat4 invViewProjection = glm::inverse(frame.viewProjection);
+    glUniformMatrix4fv(lighting->getUniformFromName("MVP"), 1, GL_FALSE, glm::value_ptr(ortho));
+    glUniformMatrix4fv(lighting->getUniformFromName("invViewProjection"), 1, GL_FALSE, glm::value_ptr(invViewProjection));
+    glUniform3fv(lighting->getUniformFromName("cameraPosition"), 1, glm::value_ptr(frame.cameraPosition));
+    glUniform3fv(lighting->getUniformFromName("ballCenter"), 1, glm::value_ptr(frame.ballPosition));
+    frameUploadBytes += 2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec3);
+    if (clustered) {
+        setClusterUniforms(lighting, screenSize);
     }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, deferredDepthTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, deferredNormalTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, deferredAlbedoTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(fullScreenQuadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    frameDrawCount++;
+
+    lighting->deactivate();
 }
 
+// Rasterizes what the bottom left `traceSize` part of the screen sees into the G-buffer, and binds it to
+// texture units 2 to 4 for the hybrid ray tracer
+void renderGBuffer(FrameSnapshot const& frame, glm::ivec2 traceSize) {
+    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFramebuffer);
+    glViewport(0, 0, traceSize.x, traceSize.y);
+
+    // Only the depth needs clearing, the ray tracer ignores the other targets where nothing was drawn
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // The rasterizer samples pixel centers, but the ray tracer shoots its primary rays through pixel corners. Moving
+    // the image half a pixel up and right puts the corners where the centers were.
+    glm::mat4 cornerOffset = glm::translate(glm::vec3(1.0f / traceSize.x, 1.0f / traceSize.y, 0.0f));
+
+    gbufferShader->activate();
+    GLint materialLocation = gbufferShader->getUniformFromName("materialID");
+    for (DrawItem const& item : frame.drawList) {
+        glm::mat4 modelViewProjection = cornerOffset * item.modelViewProjection;
+        glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(modelViewProjection));
+        glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+        glUniformMatrix3fv(5, 1, GL_FALSE, glm::value_ptr(item.normalMatrix));
+        glUniform1ui(materialLocation, item.materialID);
+        frameUploadBytes += 2 * sizeof(glm::mat4) + sizeof(glm::mat3) + sizeof(GLuint);
+
+        drawItemGeometry(item, -1);
+    }
+    gbufferShader->deactivate();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, gbufferDepthTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, gbufferNormalTexture);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, gbufferMaterialTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Times every ray tracer layout on the frame that is about to be rendered and keeps the fastest for this GPU
+void tuneRayTracer() {
+    const FrameSnapshot& frame = *renderedFrame;
+    int bounces = frame.settings.rayTracingBounces;
+
+    beginFrameRing();
+    uploadRayTracerInputs(frame, -1);
+
+    // Only the plain variant is timed, but a layout also has to work with the features that are on
+    RayTracerFeatures features = rayTracerFeatures(frame.settings, bounces);
+    rayTracerLayout = tuneRayTracerLayout(
+        [bounces, &features](RayTracerLayout const& layout) {
+            rayTracerShaders->prepare(rayTracerVariant({bounces}, layout));
+            rayTracerShaders->prepare(rayTracerVariant(features, layout));
+        },
+        [bounces, &features](RayTracerLayout const& layout) {
+            return rayTracerShaders->get(rayTracerVariant({bounces}, layout))->isValid()
+                && rayTracerShaders->get(rayTracerVariant(features, layout))->isValid();
+        },
+        [bounces, &frame](RayTracerLayout const& layout) {
+            glm::ivec2 fullSize(windowWidth, windowHeight);
+            dispatchRayTracer(rayTracerShaders->get(rayTracerVariant({bounces}, layout)), layout, int(frame.triangleCount), fullSize);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        });
+
+    glUseProgram(0);
+    endFrameRing();
+    saveTunedLayout(rayTracerLayout);
+
+    // The output texture holds the last candidate's image, don't reproject from it
+    rayTracingHistory.valid = false;
+}
+
+// Whether last frame's ray traced image can be reprojected into this one
+bool canReuseRayTracingHistory(FrameSnapshot const& frame, glm::ivec2 traceSize, int bounces) {
+    RayTracingHistory const& history = rayTracingHistory;
+    if (!frame.settings.temporalReprojection || !history.valid
+        || history.traceSize != traceSize || history.bounces != bounces
+        || history.hybrid != frame.settings.hybridPrimary || history.wavefront != frame.settings.wavefront
+        || history.triangleCount != frame.triangleCount || history.lights.size() != frame.lights.size()) {
+        return false;
+    }
+
+    // Moving lights change the shading everywhere
+    for (size_t i = 0; i < frame.lights.size(); i++) {
+        if (history.lights[i].position != frame.lights[i].position || history.lights[i].color != frame.lights[i].color) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Renders the last simulated frame, only reads the snapshot and never the scene graph
 void renderFrame(GLFWwindow* window) {
     int windowWidth, windowHeight;
     glfwGetWindowSize(window, &windowWidth, &windowHeight);
     glViewport(0, 0, windowWidth, windowHeight);
 
+    const FrameSnapshot& frame = *renderedFrame;
+    frameUploadBytes    = 0;
+    frameDrawCount      = 0;
+    frameTriangleCount  = frame.triangleCount;
+    frameGatherMs       = frame.gatherMs;
+
+    // Everything uploaded from here until the end of the frame goes into this frame's slot
+    beginFrameRing();
+
 
     // --- 3D rendering ---
-    if (!rtEnabled) {
-        shader->activate();
+    if (!frame.settings.rayTracing) {
+        // Decide on the GPU which nodes are hidden behind what was drawn last frame
+        if (frame.settings.occlusionCulling) {
+            collectOcclusionInstances(frame.drawList);
+            cullInstances(occlusionInstances);
+            frameUploadBytes += occlusionInstances.size() * sizeof(OcclusionInstance);
+        }
 
-        // Set numLights in the shader
-        int numLights = lightsData.size();
-        glUniform1i(shader->getUniformFromName("numLights"), numLights);
+        uploadLightBuffer(frame.lights);
 
-        // Upload light data to the shader
-        for (int i = 0; i < numLights; i++) {
-            std::string posName = fmt::format("lights[{}].position", i);
-            std::string colName = fmt::format("lights[{}].color", i);
+        // Sort the lights into the clusters of the view frustum
+        bool clustered = frame.settings.clusteredShading;
+        if (clustered) {
+            clusterLights(frame.view, frame.projection);
+        }
+
+        // Deferred shading draws the geometry into the G-buffer, and shades it afterwards
+        bool deferred = frame.settings.deferredShading;
+        ScenePass pass = deferred ? GBUFFER_PASS : FORWARD_PASS;
+        if (deferred) {
+            glBindFramebuffer(GL_FRAMEBUFFER, deferredFramebuffer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+
+        // The forward path can lay down the depth first, and then only shade the fragments that end up visible
+        bool depthPrepass = frame.settings.depthPrepass && !deferred;
+        if (depthPrepass) {
+            renderDepthPrepass(frame);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+
+        // Every kind of node is drawn with its own shader variant, so the program only changes once per kind
+        const SceneNodeType variantTypes[] = { GEOMETRY, NORMAL_MAPPED_GEOMETRY };
+        for (SceneNodeType type : variantTypes) {
+            Gloom::Shader* variant = sceneShaders->get(sceneVariant(type == NORMAL_MAPPED_GEOMETRY, clustered && !deferred, pass));
+            variant->activate();
+            if (clustered && !deferred) {
+                setClusterUniforms(variant, glm::ivec2(windowWidth, windowHeight));
+            }
+
+            // Upload camera and ball position to the shader
+            glUniform3fv(variant->getUniformFromName("cameraPosition"), 1, glm::value_ptr(frame.cameraPosition));
+            glUniform3fv(variant->getUniformFromName("ballCenter"), 1, glm::value_ptr(frame.ballPosition));
+            frameUploadBytes += 2 * sizeof(glm::vec3);
+
+            for (size_t i = 0; i < frame.drawList.size(); i++) {
+                if (frame.drawList[i].nodeType == type) {
+                    renderDrawItem(frame.drawList[i], frame.settings.occlusionCulling ? int(i) : -1);
+                }
+            }
+        }
+
+        if (depthPrepass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
 
-            GLint locPos = shader->getUniformFromName(posName);
-            GLint locCol = shader->getUniformFromName(colName);
+        if (deferred) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            renderDeferredLighting(frame, clustered, glm::ivec2(windowWidth, windowHeight));
+        }
 
-            glUniform3fv(locPos, 1, glm::value_ptr(lightsData[i].position));
-            glUniform3fv(locCol, 1, glm::value_ptr(lightsData[i].color));
+        // Keep this frame's depth around for culling the next one
+        if (frame.settings.occlusionCulling) {
+            buildDepthPyramid(frame.viewProjection);
+        } else {
+            invalidateDepthPyramid();
         }
+    }
+    else {
+        // Nothing was rasterized, so there is no depth to cull against next frame
+        invalidateDepthPyramid();
+    }
 
-        renderNode3D(rootNode);
+    if (!frame.settings.rayTracing) {
+        rayTracingHistory.valid = false;
+        lightReservoirHistory.valid = false;
     }
 
-    // Deactivate the 3D one, might be active even if RT is enabled due to how I've set up the uniform updates in updateFrame()
-    // This is a bit of a hack, but it works for now. Revisit later.
-    shader->deactivate();
+    glUseProgram(0);
 
 
     // --- Ray tracing ---
-    if (rtEnabled) {
-        computeShader->activate();
-    
-        glm::mat4 projection = glm::perspective(glm::radians(80.0f),
-                                                float(windowWidth) / float(windowHeight),
-                                                0.1f, 350.f);
-    
-        glm::vec3 rtCameraPosition;
-        glm::mat4 rtView;
-        if (freeCameraActive) {
-            // Use the free camera’s view matrix.
-            rtView = freeCam->getViewMatrix();
-
-            // Extract the camera position from the inverse of the view matrix.
-            glm::mat4 invFreeView = glm::inverse(rtView);
-            rtCameraPosition = glm::vec3(invFreeView[3]);
+    if (frame.settings.rayTracing) {
+        // The output texture is as large as the window, dynamic resolution traces only part of it
+        glm::ivec2 textureSize(::windowWidth, ::windowHeight);
+        glm::ivec2 traceSize = textureSize;
+        int bounces = frame.settings.rayTracingBounces;
+        if (frame.settings.dynamicResolution) {
+            float scale = dynamicResolution->scale();
+            traceSize.x = std::max(int(textureSize.x * scale + 0.5f), 1);
+            traceSize.y = std::max(int(textureSize.y * scale + 0.5f), 1);
+            bounces = std::min(bounces, dynamicResolution->bounceLimit());
         }
-        else {
-            // Fixed camera, use the original camera position.
-            rtCameraPosition = glm::vec3(initialCameraPosition);
-            rtView =
-                glm::rotate(glm::mat4(1.0f),
-                            0.3f + 0.2f * (-static_cast<float>(padPositionZ * padPositionZ)),
-                            glm::vec3(1, 0, 0)) *
-                glm::rotate(glm::mat4(1.0f),
-                            -0.6f / (1.0f + expf(-5.0f * (static_cast<float>(padPositionX) - 0.5f))) + 0.3f,
-                            glm::vec3(0, 1, 0)) *
-                glm::translate(glm::mat4(1.0f), -rtCameraPosition);
+
+        // Write the other texture than last frame, so that it can be read back as history
+        rayTracedTextureIndex = 1 - rayTracedTextureIndex;
+        int tracePhase = canReuseRayTracingHistory(frame, traceSize, bounces) ? rayTracingHistory.tracePhase : -1;
+
+        RayTracerFeatures features = rayTracerFeatures(frame.settings, bounces);
+
+        bool reservoirHistory = false;
+        if (features.lightReuse) {
+            reservoirHistory = bindLightReservoirs(frame, traceSize, features.lightSamples);
+        } else {
+            lightReservoirHistory.valid = false;
         }
-    
-        glm::mat4 invView = glm::inverse(rtView);
-        glm::mat4 invProjection = glm::inverse(projection);
-    
-        // Bind output texture as image unit 0 for write access
-        glBindImageTexture(0, rayTracedTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-    
-        // Set uniforms for the compute shader
-        glUniformMatrix4fv(glGetUniformLocation(computeShader->get(), "invProjection"), 1, GL_FALSE, glm::value_ptr(invProjection));
-        glUniformMatrix4fv(glGetUniformLocation(computeShader->get(), "invView"), 1, GL_FALSE, glm::value_ptr(invView));
-        glUniform3fv(glGetUniformLocation(computeShader->get(), "cameraPosition"), 1, glm::value_ptr(rtCameraPosition));    
-
-        // Set ambient light
-        glm::vec3 ambient(0.1f, 0.1f, 0.1f);
-        glUniform3fv(glGetUniformLocation(computeShader->get(), "ambientColor"), 1, glm::value_ptr(ambient));
-
-        // Upload multiple lights to the compute shader
-        int numLights = lightsData.size();
-        glUniform1i(glGetUniformLocation(computeShader->get(), "numLights"), numLights);
-        for (int i = 0; i < numLights; i++) {
-            std::string posName = fmt::format("lights[{}].position", i);
-            std::string colName = fmt::format("lights[{}].color", i);
-            glUniform3fv(glGetUniformLocation(computeShader->get(), posName.c_str()), 1, glm::value_ptr(lightsData[i].position));
-            glUniform3fv(glGetUniformLocation(computeShader->get(), colName.c_str()), 1, glm::value_ptr(lightsData[i].color));
+        uploadRayTracerInputs(frame, tracePhase, reservoirHistory);
+
+        // The timer covers the G-buffer pass too, it replaces tracing the primary rays
+        bool hybrid = features.hybrid;
+        rayTracingTimer->begin();
+        if (hybrid) {
+            renderGBuffer(frame, traceSize);
+            glViewport(0, 0, windowWidth, windowHeight);
         }
 
-        if (!triangleSSBO) {
-            glGenBuffers(1, &triangleSSBO);
+        if (frame.settings.wavefront) {
+            traceWavefront(
+                [&features](WavefrontStage stage) {
+                    return rayTracerShaders->get(wavefrontVariant(features, stage));
+                },
+                rayTracerLayout, int(frame.triangleCount), traceSize, hybrid ? 1 : 0, bounces);
+        } else {
+            if (features.binned) {
+                glm::ivec2 tileSize(rayTracerLayout.localSizeX, rayTracerLayout.localSizeY);
+                binTriangles(frame.viewProjection, traceSize, tileSize, int(frame.triangleCount));
+            }
+            dispatchRayTracer(rayTracerShaders->get(rayTracerVariant(features)), rayTracerLayout, int(frame.triangleCount), traceSize);
         }
-        
-        // Upload the data
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER,
-                     allTriangles.size() * sizeof(Triangle),
-                     allTriangles.data(),
-                     GL_DYNAMIC_DRAW);
-        
-        // Bind to some binding index for the compute shader
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, triangleSSBO);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-        
-        // Also pass the count as a uniform
-        int triCount = (int) allTriangles.size();
-        glUniform1i(glGetUniformLocation(computeShader->get(), "numTriangles"), triCount);
+        rayTracingTimer->end();
 
-        if (!materialSSBO) {
-            glGenBuffers(1, &materialSSBO);
+        double rayTracingMs;
+        while (rayTracingTimer->read(rayTracingMs)) {
+            if (frame.settings.dynamicResolution) {
+                dynamicResolution->update(rayTracingMs);
+            }
+        }
+        if (!frame.settings.dynamicResolution) {
+            dynamicResolution->reset();
         }
 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER,
-                     gMaterials.size() * sizeof(Material),
-                     gMaterials.data(),
-                     GL_STATIC_DRAW);
-
-        // Binding index = 2 must match `layout(std430, binding=2)` in compute
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, materialSSBO);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-    
-        // Dispatch the compute shader
-        GLuint workGroupsX = (windowWidth + 15) / 16;
-        GLuint workGroupsY = (windowHeight + 15) / 16;
-        glDispatchCompute(workGroupsX, workGroupsY, 1);
+        // Remember what this image was traced with for the next frame
+        rayTracingHistory.valid          = true;
+        rayTracingHistory.viewProjection = frame.viewProjection;
+        rayTracingHistory.cameraPosition = frame.cameraPosition;
+        rayTracingHistory.ballPosition   = frame.ballPosition;
+        rayTracingHistory.traceSize      = traceSize;
+        rayTracingHistory.bounces        = bounces;
+        rayTracingHistory.hybrid         = frame.settings.hybridPrimary;
+        rayTracingHistory.wavefront      = frame.settings.wavefront;
+        rayTracingHistory.triangleCount  = frame.triangleCount;
+        rayTracingHistory.lights         = frame.lights;
+        rayTracingHistory.tracePhase     = (rayTracingHistory.tracePhase + 1) % 4;
     
-        // Wait for compute shader to finish writing
-        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        // Wait for compute shader to finish writing, the light reservoirs are read back next frame
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
     
-        computeShader->deactivate();
+        glUseProgram(0);
     
-        // --- Render the output texture to the screen ---
-        shader2D->activate();
+        // --- Upscale the traced part of the output texture to the screen ---
+        upscaleShader->activate();
     
         // Set up an orthographic projection that covers the full screen
         glm::mat4 orthoCS = glm::ortho(0.0f, float(windowWidth), 0.0f, float(windowHeight), -1.0f, 1.0f);
-        GLint mvpLocCS = glGetUniformLocation(shader2D->get(), "MVP");
-        glUniformMatrix4fv(mvpLocCS, 1, GL_FALSE, glm::value_ptr(orthoCS));
+        glUniformMatrix4fv(upscaleShader->getUniformFromName("MVP"), 1, GL_FALSE, glm::value_ptr(orthoCS));
+
+        glm::vec2 traceScale = glm::vec2(traceSize) / glm::vec2(textureSize);
+        glUniform2fv(upscaleShader->getUniformFromName("traceScale"), 1, glm::value_ptr(traceScale));
     
         // Bind the ray traced texture to texture unit 0
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, rayTracedTexture);
-        GLint samplerLoc = glGetUniformLocation(shader2D->get(), "textSampler");
-        glUniform1i(samplerLoc, 0);
+        glBindTexture(GL_TEXTURE_2D, rayTracedTextures[rayTracedTextureIndex]);
+        glUniform1i(upscaleShader->getUniformFromName("tracedImage"), 0);
     
         // Render the full-screen quad
         glBindVertexArray(fullScreenQuadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(0);
     
-        shader2D->deactivate();
+        upscaleShader->deactivate();
     }
 
 
@@ -959,11 +2378,16 @@ void renderFrame(GLFWwindow* window) {
 
     
     glDisable(GL_DEPTH_TEST);
-    renderNode2D(rootNode, ortho);
+    for (DrawItem2D const& item : frame.drawList2D) {
+        renderDrawItem2D(item, ortho);
+    }
     glEnable(GL_DEPTH_TEST);
 
     shader2D->deactivate();
 
-    // Re-enable the 3D shader for the next frame so that updateFrame() can set uniforms
-    shader->activate();
+    // The frame ring slot of this frame can be reused once the GPU is past this point
+    endFrameRing();
+
+    // The frame is submitted, compile a ray tracer variant it may switch to later
+    prepareBackgroundRayTracerVariant(frame.settings);
 }
@@ -1,9 +1,38 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
 #include <utilities/window.hpp>
 #include "sceneGraph.hpp"
 
+// Per-frame numbers reported by the benchmark harness
+struct FrameStats {
+    size_t triangleCount;
+    size_t uploadBytes;
+    size_t drawCount;
+    double gatherMs;        // CPU time spent gathering the ray tracer's triangles
+};
+
 void updateNodeTransformations(SceneNode* node, glm::mat4 transformationThusFar, glm::mat4 VP);
 void initGame(GLFWwindow* window, CommandLineOptions options);
 void updateFrame(GLFWwindow* window);
-void renderFrame(GLFWwindow* window);
\ No newline at end of file
+void renderFrame(GLFWwindow* window);
+
+// updateFrame() starts simulating the next frame on the simulation thread while renderFrame() draws the previous
+// one, this waits for the simulation and makes its result the frame the next renderFrame() draws
+void finishFrameUpdate();
+
+// Replaces the generated stress scene inside the box
+void setStressScene(unsigned int objectCount, unsigned int lightCount, unsigned int seed);
+void setRayTracingEnabled(bool enabled);
+void setDeferredShadingEnabled(bool enabled);
+FrameStats getFrameStats();
+
+// Times the CPU gather of the full trophy model on one thread and on the gather pool, and prints both
+void reportTrophyGatherTime();
+
+// Writes the current scene graph to a binary scene file
+bool exportScene(std::string const &filename);
+
+// Writes the key frames of the song to a binary beat map file
+bool exportBeatMap(std::string const &filename);
@@ -0,0 +1,148 @@
+#include "gpuTransform.hpp"
+
+#include <unordered_map>
+#include <utilities/frameRing.hpp>
+#include <utilities/shader.hpp>
+
+namespace {
+    // Layouts match transform.comp (std430)
+    struct LocalVertex {
+        glm::vec4 position;
+        glm::vec4 normal;
+    };
+
+    struct MeshRange {
+        GLuint firstIndex;
+        GLuint baseVertex;
+        GLuint hasNormals;
+        GLuint pad0;
+    };
+
+    struct TransformInstance {
+        glm::mat4 modelMatrix;
+        glm::vec4 normalMatrix[3];    // the columns of a std430 mat3 are vec4 aligned
+        GLuint firstTriangle;
+        GLuint mesh;
+        GLuint materialID;
+        GLuint pad0;
+    };
+}
+
+static Gloom::Shader* transformShader;
+
+static GLuint vertexSSBO = 0;
+static GLuint indexSSBO = 0;
+static GLuint meshSSBO = 0;
+static GLuint triangleSSBO = 0;
+static size_t triangleCapacity = 0;
+
+// Meshes in the order they were made resident, their position in this list is their index in meshes[]
+static std::vector<const Mesh*> residentMeshes;
+static std::unordered_map<const Mesh*, GLuint> meshIndexByMesh;
+
+static std::vector<TransformInstance> instances;
+
+void initGpuTransform() {
+    transformShader = new Gloom::Shader();
+    transformShader->attach("../res/shaders/transform.comp");
+    transformShader->link();
+
+    glGenBuffers(1, &vertexSSBO);
+    glGenBuffers(1, &indexSSBO);
+    glGenBuffers(1, &meshSSBO);
+    glGenBuffers(1, &triangleSSBO);
+}
+
+// Rebuilds the resident buffers from every mesh seen so far. Meshes only get added while a scene is built,
+// so this is rare enough that appending in place isn't worth the bookkeeping.
+static size_t uploadResidentMeshes() {
+    std::vector<LocalVertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<MeshRange> ranges;
+
+    for (const Mesh* mesh : residentMeshes) {
+        MeshRange range;
+        range.firstIndex = GLuint(indices.size());
+        range.baseVertex = GLuint(vertices.size());
+        range.hasNormals = mesh->normals.empty() ? 0 : 1;
+        range.pad0 = 0;
+        ranges.push_back(range);
+
+        for (size_t i = 0; i < mesh->vertices.size(); i++) {
+            LocalVertex vertex;
+            vertex.position = glm::vec4(mesh->vertices[i], 1.0f);
+            vertex.normal   = range.hasNormals ? glm::vec4(mesh->normals[i], 0.0f) : glm::vec4(0.0f);
+            vertices.push_back(vertex);
+        }
+        indices.insert(indices.end(), mesh->indices.begin(), mesh->indices.end());
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(LocalVertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ranges.size() * sizeof(MeshRange), ranges.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    return vertices.size() * sizeof(LocalVertex) + indices.size() * sizeof(GLuint) + ranges.size() * sizeof(MeshRange);
+}
+
+GLuint transformTrianglesOnGpu(std::vector<GatherJob> const &jobs, size_t triangleCount, size_t &uploadBytes) {
+    bool newMeshes = false;
+    instances.clear();
+
+    for (GatherJob const &job : jobs) {
+        auto it = meshIndexByMesh.find(job.mesh);
+        if (it == meshIndexByMesh.end()) {
+            it = meshIndexByMesh.insert({job.mesh, GLuint(residentMeshes.size())}).first;
+            residentMeshes.push_back(job.mesh);
+            newMeshes = true;
+        }
+
+        TransformInstance instance;
+        instance.modelMatrix   = job.modelMatrix;
+        for (int column = 0; column < 3; column++) {
+            instance.normalMatrix[column] = glm::vec4(job.normalMatrix[column], 0.0f);
+        }
+        instance.firstTriangle = GLuint(job.firstTriangle);
+        instance.mesh          = it->second;
+        instance.materialID    = job.materialID;
+        instance.pad0          = 0;
+        instances.push_back(instance);
+    }
+
+    if (newMeshes) {
+        uploadBytes += uploadResidentMeshes();
+    }
+
+    // Only written by the GPU, grows but never shrinks
+    if (triangleCount > triangleCapacity) {
+        triangleCapacity = triangleCount;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, triangleCapacity * sizeof(Triangle), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    if (triangleCount == 0) {
+        return triangleSSBO;
+    }
+
+    uploadFrameData(GL_SHADER_STORAGE_BUFFER, 6, instances.data(), instances.size() * sizeof(TransformInstance));
+    uploadBytes += instances.size() * sizeof(TransformInstance);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, triangleSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vertexSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, indexSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, meshSSBO);
+
+    transformShader->activate();
+    glUniform1i(transformShader->getUniformFromName("numTriangles"), int(triangleCount));
+    glUniform1i(transformShader->getUniformFromName("numInstances"), int(instances.size()));
+    glDispatchCompute(GLuint((triangleCount + 63) / 64), 1, 1);
+
+    // The ray tracer reads the triangles right after
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    return triangleSSBO;
+}
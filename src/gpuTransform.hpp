@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include "triangleGather.hpp"
+
+// World space triangles for the ray tracer, transformed on the GPU. The local space vertices and indices of every
+// mesh stay resident in shader storage buffers, so a frame only uploads one model matrix per instance.
+
+void initGpuTransform();
+
+// Writes the world space triangles of the jobs into the triangle buffer and returns that buffer. Meshes seen for the
+// first time are made resident. Everything uploaded is added to `uploadBytes`.
+GLuint transformTrianglesOnGpu(std::vector<GatherJob> const &jobs, size_t triangleCount, size_t &uploadBytes);
@@ -0,0 +1,59 @@
+#include "lightClustering.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+static Gloom::Shader* clusterShader;
+
+static GLuint clusterRangeBuffer = 0;
+static GLuint clusterListBuffer = 0;
+
+// Near and far plane of the last clustered projection
+static glm::vec2 clusterDepthRange(0.1f, 1.0f);
+
+static size_t clusterCount() {
+    return size_t(clusterGrid.x) * size_t(clusterGrid.y) * size_t(clusterGrid.z);
+}
+
+void initLightClustering() {
+    clusterShader = new Gloom::Shader();
+    clusterShader->attach("../res/shaders/cluster.comp");
+    clusterShader->link();
+
+    // Neither the grid nor the slot of every cluster ever changes size, so neither do the buffers
+    glGenBuffers(1, &clusterRangeBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterRangeBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount() * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &clusterListBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterListBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount() * clusterCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void clusterLights(glm::mat4 const &view, glm::mat4 const &projection) {
+    // The planes of a glm::perspective() projection
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane  = projection[3][2] / (projection[2][2] + 1.0f);
+    clusterDepthRange = glm::vec2(nearPlane, farPlane);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, clusterRangeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, clusterListBuffer);
+
+    clusterShader->activate();
+    glm::mat4 invProjection = glm::inverse(projection);
+    glUniformMatrix4fv(clusterShader->getUniformFromName("view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(clusterShader->getUniformFromName("invProjection"), 1, GL_FALSE, glm::value_ptr(invProjection));
+    glUniform3i(clusterShader->getUniformFromName("clusterGrid"), clusterGrid.x, clusterGrid.y, clusterGrid.z);
+    glUniform2fv(clusterShader->getUniformFromName("clusterDepthRange"), 1, glm::value_ptr(clusterDepthRange));
+    glUniform1ui(clusterShader->getUniformFromName("clusterCapacity"), GLuint(clusterCapacity));
+    glDispatchCompute(GLuint((clusterCount() + 63) / 64), 1, 1);
+    clusterShader->deactivate();
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void setClusterUniforms(Gloom::Shader* program, glm::ivec2 screenSize) {
+    glUniform3i(program->getUniformFromName("clusterGrid"), clusterGrid.x, clusterGrid.y, clusterGrid.z);
+    glUniform2fv(program->getUniformFromName("clusterDepthRange"), 1, glm::value_ptr(clusterDepthRange));
+    glUniform2f(program->getUniformFromName("clusterScreenSize"), float(screenSize.x), float(screenSize.y));
+}
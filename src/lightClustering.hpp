@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <utilities/shader.hpp>
+
+// Clustered forward shading for the raster path. The view frustum is cut into a grid of clusters, screen space tiles
+// split into depth slices, and a compute pass lists the lights that reach every cluster, so that simple.frag only
+// loops over the lights of its own cluster instead of over every light.
+
+// Tiles across and up the screen, and depth slices
+const glm::ivec3 clusterGrid(16, 9, 24);
+
+// Light list entries of every cluster. A cluster that more lights reach shades with every light instead.
+const int clusterCapacity = 256;
+
+void initLightClustering();
+
+// Assigns the lights bound to shader storage binding 0 to the clusters of the frustum seen through `view`
+// and `projection`, and leaves the cluster ranges and light lists bound to bindings 5 and 6 for simple.frag
+void clusterLights(glm::mat4 const &view, glm::mat4 const &projection);
+
+// Sets the uniforms simple.frag finds its cluster with, for a framebuffer of `screenSize` pixels
+void setClusterUniforms(Gloom::Shader* program, glm::ivec2 screenSize);
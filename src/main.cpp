@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 
 // Standard headers
+#include <algorithm>
 #include <cstdlib>
 #include <arrrgh.hpp>
 
@@ -69,6 +70,22 @@ int main(int argc, const char* argb[])
     arrrgh::parser parser("glowbox", "Small breakout like juggling game");
     const auto& showHelp       = parser.add<bool>("help", "Show this help message.", 'h', arrrgh::Optional, false);
     const auto& enableAutoplay = parser.add<bool>("autoplay", "Let the game play itself automatically. Useful for testing.", 'a', arrrgh::Optional, false);
+    const auto& scenePath      = parser.add<std::string>("scene", "Load this binary scene file instead of the built-in scene.", 'f', arrrgh::Optional, "");
+    const auto& exportScene    = parser.add<std::string>("export-scene", "Write the scene to this binary scene file and exit.", 'e', arrrgh::Optional, "");
+    const auto& beatMapPath    = parser.add<std::string>("beat-map", "Load the key frames of the song from this binary beat map.", 'm', arrrgh::Optional, "");
+    const auto& exportBeatMap  = parser.add<std::string>("export-beat-map", "Write the key frames of the song to this binary beat map and exit.", 'M', arrrgh::Optional, "");
+    const auto& tuneRayTracer  = parser.add<bool>("tune", "Time the ray tracer work group layouts on this GPU at startup and keep the fastest.", 'u', arrrgh::Optional, false);
+    const auto& dynamicRes     = parser.add<bool>("dynamic-resolution", "Start with dynamic ray tracing resolution enabled.", 'y', arrrgh::Optional, false);
+    const auto& targetFps      = parser.add<int>("target-fps", "Frame rate dynamic resolution tries to hold.", 'p', arrrgh::Optional, 60);
+    const auto& rtFormat       = parser.add<std::string>("rt-format", "Ray traced color format: r11f_g11f_b10f, rgba16f or rgba32f.", 'r', arrrgh::Optional, "r11f_g11f_b10f");
+    const auto& lightSamples   = parser.add<int>("light-samples", "Lights the ray tracer samples per hit when light sampling is on (1 to 8).", 'g', arrrgh::Optional, 1);
+    const auto& stressObjects  = parser.add<int>("stress-objects", "Fill the box with this many random trophies, spheres and cubes.", 'n', arrrgh::Optional, 0);
+    const auto& stressLights   = parser.add<int>("stress-lights", "Add this many random point lights to the box.", 'l', arrrgh::Optional, 0);
+    const auto& stressSeed     = parser.add<int>("seed", "Seed for the stress scene generator.", 's', arrrgh::Optional, 1);
+    const auto& runBenchmark   = parser.add<bool>("benchmark", "Sweep stress scene sizes on both render paths and log the results, then exit.", 'b', arrrgh::Optional, false);
+    const auto& benchmarkOut   = parser.add<std::string>("benchmark-output", "CSV file the benchmark results are written to.", 'o', arrrgh::Optional, "benchmark.csv");
+    const auto& sweepObjects   = parser.add<std::string>("sweep-objects", "Comma separated object counts for the benchmark sweep.", 'N', arrrgh::Optional, "0,25,50,100,200");
+    const auto& sweepLights    = parser.add<std::string>("sweep-lights", "Comma separated light counts for the benchmark sweep.", 'L', arrrgh::Optional, "1,4,16,64");
 
     try
     {
@@ -89,6 +106,22 @@ int main(int argc, const char* argb[])
 
     CommandLineOptions options;
     options.enableAutoplay = enableAutoplay.value();
+    options.scenePath       = scenePath.value();
+    options.exportScenePath = exportScene.value();
+    options.beatMapPath       = beatMapPath.value();
+    options.exportBeatMapPath = exportBeatMap.value();
+    options.tuneRayTracer     = tuneRayTracer.value();
+    options.dynamicResolution = dynamicRes.value();
+    options.targetFps         = std::max(targetFps.value(), 1);
+    options.rayTracingFormat  = rtFormat.value();
+    options.lightSamples      = std::min(std::max(lightSamples.value(), 1), 8);
+    options.stressObjects  = std::max(stressObjects.value(), 0);
+    options.stressLights   = std::max(stressLights.value(), 0);
+    options.stressSeed     = stressSeed.value();
+    options.runBenchmark          = runBenchmark.value();
+    options.benchmarkOutput       = benchmarkOut.value();
+    options.benchmarkObjectCounts = sweepObjects.value();
+    options.benchmarkLightCounts  = sweepLights.value();
 
     // Initialise window using GLFW
     GLFWwindow* window = initialise();
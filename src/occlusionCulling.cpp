@@ -0,0 +1,135 @@
+#include "occlusionCulling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/frameRing.hpp>
+#include <utilities/shader.hpp>
+
+static Gloom::Shader* hizShader;
+static Gloom::Shader* cullShader;
+
+static int pyramidWidth = 0;
+static int pyramidHeight = 0;
+static int pyramidLevels = 0;
+
+static GLuint depthCopyTexture = 0;
+static GLuint depthCopyFramebuffer = 0;
+static GLuint hizTexture = 0;
+
+static GLuint commandBuffer = 0;
+static size_t commandCapacity = 0;
+
+static bool pyramidValid = false;
+static glm::mat4 pyramidViewProjection(1.0f);
+
+void initOcclusionCulling(int width, int height) {
+    pyramidWidth  = width;
+    pyramidHeight = height;
+    pyramidLevels = int(std::floor(std::log2(float(std::max(width, height))))) + 1;
+
+    hizShader = new Gloom::Shader();
+    hizShader->attach("../res/shaders/hiz.comp");
+    hizShader->link();
+
+    cullShader = new Gloom::Shader();
+    cullShader->attach("../res/shaders/cull.comp");
+    cullShader->link();
+
+    // The default framebuffer is multisampled and can't be sampled, so its depth is resolved into this texture.
+    // Depth blits need matching formats, GLFW asks for 24 bit depth + 8 bit stencil by default.
+    glGenTextures(1, &depthCopyTexture);
+    glBindTexture(GL_TEXTURE_2D, depthCopyTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glGenFramebuffers(1, &depthCopyFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, depthCopyFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthCopyTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Farthest depth pyramid, with a full mip chain
+    glGenTextures(1, &hizTexture);
+    glBindTexture(GL_TEXTURE_2D, hizTexture);
+    glTexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &commandBuffer);
+}
+
+void cullInstances(std::vector<OcclusionInstance> const &instances) {
+    uploadFrameData(GL_SHADER_STORAGE_BUFFER, 3, instances.data(), instances.size() * sizeof(OcclusionInstance));
+
+    // Only written by the GPU, grows but never shrinks
+    if (instances.size() > commandCapacity || commandCapacity == 0) {
+        commandCapacity = std::max<size_t>(instances.size(), 1);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commandCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, commandBuffer);
+
+    cullShader->activate();
+    glUniform1i(cullShader->getUniformFromName("numInstances"), int(instances.size()));
+    glUniform1i(cullShader->getUniformFromName("hizValid"), pyramidValid ? 1 : 0);
+    glUniform1i(cullShader->getUniformFromName("hizLevels"), pyramidLevels);
+    glUniformMatrix4fv(cullShader->getUniformFromName("previousViewProjection"), 1, GL_FALSE, glm::value_ptr(pyramidViewProjection));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hizTexture);
+    glUniform1i(cullShader->getUniformFromName("hizTexture"), 0);
+
+    if (!instances.empty()) {
+        glDispatchCompute(GLuint((instances.size() + 63) / 64), 1, 1);
+    }
+    cullShader->deactivate();
+
+    // The draws read the commands written above
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+}
+
+void buildDepthPyramid(glm::mat4 const &viewProjection) {
+    // Resolve the multisampled depth buffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthCopyFramebuffer);
+    glBlitFramebuffer(0, 0, pyramidWidth, pyramidHeight, 0, 0, pyramidWidth, pyramidHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    hizShader->activate();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depthCopyTexture);
+    glUniform1i(hizShader->getUniformFromName("depthTexture"), 0);
+
+    for (int level = 0; level < pyramidLevels; level++) {
+        int levelWidth  = std::max(pyramidWidth >> level, 1);
+        int levelHeight = std::max(pyramidHeight >> level, 1);
+
+        glUniform1i(hizShader->getUniformFromName("targetLevel"), level);
+        glBindImageTexture(0, hizTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute(GLuint((levelWidth + 7) / 8), GLuint((levelHeight + 7) / 8), 1);
+
+        // The next level reads this one
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    hizShader->deactivate();
+
+    // The culling pass samples the pyramid
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    pyramidValid = true;
+    pyramidViewProjection = viewProjection;
+}
+
+void invalidateDepthPyramid() {
+    pyramidValid = false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// GPU occlusion culling against a hierarchical depth (Hi-Z) pyramid built from the previous frame's depth buffer.
+// The culling pass writes indirect draw commands, so occluded instances never reach the vertex or fragment stage
+// and nothing has to be read back to the CPU.
+
+// Per-instance input of the culling pass, layout matches `Instance` in cull.comp (std430)
+struct OcclusionInstance {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    unsigned int indexCount;
+    unsigned int pad0, pad1, pad2;
+};
+
+// Layout of the commands read by glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+};
+
+void initOcclusionCulling(int width, int height);
+
+// Tests the instances against the depth pyramid and writes one draw command per instance into the command buffer,
+// which is left bound to GL_DRAW_INDIRECT_BUFFER. Draw instance i with an offset of i * sizeof(DrawElementsIndirectCommand).
+void cullInstances(std::vector<OcclusionInstance> const &instances);
+
+// Copies the depth buffer of the frame just rasterized with `viewProjection` and builds the pyramid from it
+void buildDepthPyramid(glm::mat4 const &viewProjection);
+
+// Forgets the pyramid, e.g. when the last frame was not rasterized. Everything passes until the next build.
+void invalidateDepthPyramid();
@@ -2,6 +2,7 @@
 #include "program.hpp"
 #include "utilities/window.hpp"
 #include "gamelogic.h"
+#include "benchmark.hpp"
 #include <glm/glm.hpp>
 // glm::translate, glm::rotate, glm::scale, glm::perspective
 #include <glm/gtc/matrix_transform.hpp>
@@ -34,24 +35,51 @@ void runProgram(GLFWwindow* window, CommandLineOptions options)
 
 	initGame(window, options);
 
+    if (!options.exportScenePath.empty())
+    {
+        exportScene(options.exportScenePath);
+        return;
+    }
+
+    if (!options.exportBeatMapPath.empty())
+    {
+        exportBeatMap(options.exportBeatMapPath);
+        return;
+    }
+
+    if (options.runBenchmark)
+    {
+        runBenchmark(window, options);
+        return;
+    }
+
     // Rendering Loop
     while (!glfwWindowShouldClose(window))
     {
-	    // Clear colour and depth buffers
-	    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        runFrame(window);
+    }
+}
+
 
+void runFrame(GLFWwindow* window)
+{
+    // Clear colour and depth buffers
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        updateFrame(window);
-        renderFrame(window);
 
+    // The next frame is simulated on its own thread while this one is rendered
+    updateFrame(window);
+    renderFrame(window);
 
-        // Handle other events
-        glfwPollEvents();
-        handleKeyboardInput(window);
 
-        // Flip buffers
-        glfwSwapBuffers(window);
-    }
+    // Handle other events
+    glfwPollEvents();
+    handleKeyboardInput(window);
+
+    // Flip buffers
+    glfwSwapBuffers(window);
+
+    finishFrameUpdate();
 }
 
 
@@ -14,6 +14,10 @@
 void runProgram(GLFWwindow* window, CommandLineOptions options);
 
 
+// Runs a single iteration of the rendering loop: update, render, events and buffer swap
+void runFrame(GLFWwindow* window);
+
+
 // Function for handling keypresses
 void handleKeyboardInput(GLFWwindow* window);
 
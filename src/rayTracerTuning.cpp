@@ -0,0 +1,124 @@
+#include "rayTracerTuning.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <glad/glad.h>
+#include <fmt/format.h>
+#include <utilities/programCache.hpp>
+
+// Dispatches run before timing each candidate, and timed dispatches whose median is kept
+const int tuningWarmupDispatches = 2;
+const int tuningTimedDispatches = 5;
+
+static std::string tunedLayoutPath() {
+    char name[48];
+    snprintf(name, sizeof(name), "%016llx-raytracer.txt", (unsigned long long) programCacheSeed());
+    return programCacheDirectory + "/" + name;
+}
+
+std::vector<RayTracerLayout> rayTracerLayoutCandidates() {
+    const int sizes[][2] = { {8, 8}, {16, 8}, {32, 4}, {16, 16}, {32, 8} };
+
+    std::vector<RayTracerLayout> candidates;
+    for (auto const &size : sizes) {
+        bool squarePowerOfTwo = size[0] == size[1] && (size[0] & (size[0] - 1)) == 0;
+        for (PixelMapping mapping : { PIXEL_MAPPING_LINEAR, PIXEL_MAPPING_QUADS, PIXEL_MAPPING_MORTON }) {
+            if (mapping == PIXEL_MAPPING_MORTON && !squarePowerOfTwo) {
+                continue;
+            }
+            RayTracerLayout layout;
+            layout.localSizeX = size[0];
+            layout.localSizeY = size[1];
+            layout.mapping = mapping;
+            candidates.push_back(layout);
+        }
+    }
+    return candidates;
+}
+
+std::string describeLayout(RayTracerLayout const &layout) {
+    const char* mappingNames[] = { "linear", "2x2 quads", "Morton" };
+    return fmt::format("{}x{} {}", layout.localSizeX, layout.localSizeY, mappingNames[layout.mapping]);
+}
+
+bool loadTunedLayout(RayTracerLayout &layout) {
+    std::ifstream file(tunedLayoutPath());
+    int sizeX, sizeY, mapping;
+    if (!(file >> sizeX >> sizeY >> mapping)) {
+        return false;
+    }
+
+    // Only take layouts the shader is known to handle
+    for (RayTracerLayout const &candidate : rayTracerLayoutCandidates()) {
+        if (candidate.localSizeX == sizeX && candidate.localSizeY == sizeY && candidate.mapping == mapping) {
+            layout = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool saveTunedLayout(RayTracerLayout const &layout) {
+    std::string path = tunedLayoutPath();
+    std::ofstream file(path);
+    if (file.fail()) {
+        std::cerr << "Could not write the tuned ray tracer layout to " << path << std::endl;
+        return false;
+    }
+    file << layout.localSizeX << " " << layout.localSizeY << " " << int(layout.mapping) << "\n";
+    return file.good();
+}
+
+RayTracerLayout tuneRayTracerLayout(std::function<void(RayTracerLayout const &)> prepare,
+                                    std::function<bool(RayTracerLayout const &)> usable,
+                                    std::function<void(RayTracerLayout const &)> dispatch)
+{
+    std::vector<RayTracerLayout> candidates = rayTracerLayoutCandidates();
+    for (RayTracerLayout const &candidate : candidates) {
+        prepare(candidate);
+    }
+
+    GLuint queries[tuningTimedDispatches];
+    glGenQueries(tuningTimedDispatches, queries);
+
+    RayTracerLayout best = candidates[0];
+    double bestMs = 1e30;
+    for (RayTracerLayout const &candidate : candidates) {
+        if (!usable(candidate)) {
+            std::cout << fmt::format("Ray tracer layout {:<16} does not link, skipped", describeLayout(candidate)) << std::endl;
+            continue;
+        }
+
+        for (int i = 0; i < tuningWarmupDispatches; i++) {
+            dispatch(candidate);
+        }
+
+        for (int i = 0; i < tuningTimedDispatches; i++) {
+            glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+            dispatch(candidate);
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+
+        double times[tuningTimedDispatches];
+        for (int i = 0; i < tuningTimedDispatches; i++) {
+            GLuint64 elapsedNs = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsedNs);
+            times[i] = elapsedNs / 1e6;
+        }
+        std::nth_element(times, times + tuningTimedDispatches / 2, times + tuningTimedDispatches);
+        double medianMs = times[tuningTimedDispatches / 2];
+
+        std::cout << fmt::format("Ray tracer layout {:<16} {:8.3f} ms", describeLayout(candidate), medianMs) << std::endl;
+        if (medianMs < bestMs) {
+            bestMs = medianMs;
+            best = candidate;
+        }
+    }
+
+    glDeleteQueries(tuningTimedDispatches, queries);
+
+    std::cout << fmt::format("Fastest ray tracer layout: {} ({:.3f} ms)", describeLayout(best), bestMs) << std::endl;
+    return best;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// How the threads of a ray tracer work group are laid out over its tile of pixels
+enum PixelMapping {
+    PIXEL_MAPPING_LINEAR,   // row by row, as gl_GlobalInvocationID.xy
+    PIXEL_MAPPING_QUADS,    // consecutive threads cover 2x2 pixel quads
+    PIXEL_MAPPING_MORTON    // consecutive threads follow a Z-order curve, needs a square power of two tile
+};
+
+struct RayTracerLayout {
+    int localSizeX = 16;
+    int localSizeY = 16;
+    PixelMapping mapping = PIXEL_MAPPING_LINEAR;
+};
+
+// Every work group size and mapping the tuner tries
+std::vector<RayTracerLayout> rayTracerLayoutCandidates();
+
+std::string describeLayout(RayTracerLayout const &layout);
+
+// The layout tuned earlier on this GPU and driver. Returns false if there is none.
+bool loadTunedLayout(RayTracerLayout &layout);
+bool saveTunedLayout(RayTracerLayout const &layout);
+
+// Times every candidate with GPU timer queries and returns the fastest. `prepare` is called for all candidates
+// first, so that their shaders can compile in parallel. Candidates for which `usable` returns false (a variant
+// failed to link) are skipped, for the others `dispatch` has to run one ray tracing dispatch with the given layout
+// on a fixed reference frame.
+RayTracerLayout tuneRayTracerLayout(std::function<void(RayTracerLayout const &)> prepare,
+                                    std::function<bool(RayTracerLayout const &)> usable,
+                                    std::function<void(RayTracerLayout const &)> dispatch);
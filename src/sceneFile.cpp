@@ -0,0 +1,252 @@
+#include "sceneFile.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <utilities/mappedFile.hpp>
+
+// Checks that `count` records of type T starting at `offset` lie inside a file of `fileSize` bytes
+template <class T>
+static bool tableFits(uint32_t offset, uint32_t count, size_t fileSize) {
+    return offset % alignof(T) == 0
+        && offset <= fileSize
+        && uint64_t(count) * sizeof(T) <= fileSize - offset;
+}
+
+static void copyVec3(glm::vec3 &destination, const float source[3]) {
+    destination = glm::vec3(source[0], source[1], source[2]);
+}
+
+static void copyVec3(float destination[3], glm::vec3 const &source) {
+    destination[0] = source.x;
+    destination[1] = source.y;
+    destination[2] = source.z;
+}
+
+bool loadSceneFile(std::string const &filename, SceneResources const &resources, LoadedScene &scene) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+        std::cerr << "Could not open scene file " << filename << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(SceneFileHeader)) {
+        std::cerr << "Scene file " << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    const SceneFileHeader* header = reinterpret_cast<const SceneFileHeader*>(file.data());
+    if (header->magic != sceneFileMagic || header->version != sceneFileVersion) {
+        std::cerr << "Scene file " << filename << " has an unknown format or version" << std::endl;
+        return false;
+    }
+
+    if (!tableFits<SceneFileNode>(header->nodeTableOffset, header->nodeCount, file.size())
+        || !tableFits<SceneFileResource>(header->meshTableOffset, header->meshCount, file.size())
+        || !tableFits<SceneFileResource>(header->textureTableOffset, header->textureCount, file.size())
+        || !tableFits<char>(header->stringTableOffset, header->stringTableSize, file.size())
+        || header->nodeCount == 0)
+    {
+        std::cerr << "Scene file " << filename << " is malformed" << std::endl;
+        return false;
+    }
+
+    const SceneFileNode*     nodes    = reinterpret_cast<const SceneFileNode*>(file.data() + header->nodeTableOffset);
+    const SceneFileResource* meshes   = reinterpret_cast<const SceneFileResource*>(file.data() + header->meshTableOffset);
+    const SceneFileResource* textures = reinterpret_cast<const SceneFileResource*>(file.data() + header->textureTableOffset);
+    const char*              strings  = reinterpret_cast<const char*>(file.data() + header->stringTableOffset);
+
+    // Validate the whole file before touching any GPU state, so that a bad file leaves nothing half loaded
+    auto validResource = [&](const SceneFileResource &resource) {
+        return uint64_t(resource.nameOffset) + resource.nameLength <= header->stringTableSize;
+    };
+    auto validIndex = [](int32_t index, uint32_t count) {
+        return index == -1 || (index >= 0 && uint32_t(index) < count);
+    };
+
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        if (!validResource(meshes[i])) {
+            std::cerr << "Scene file " << filename << " has a bad mesh name" << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->textureCount; i++) {
+        if (!validResource(textures[i])) {
+            std::cerr << "Scene file " << filename << " has a bad texture name" << std::endl;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->nodeCount; i++) {
+        const SceneFileNode &node = nodes[i];
+        bool validParent = (i == 0) ? node.parent == -1 : (node.parent >= 0 && uint32_t(node.parent) < i);
+        if (!validParent
+            || node.nodeType > NORMAL_MAPPED_GEOMETRY
+            || node.role >= SCENE_ROLE_COUNT
+            || !validIndex(node.mesh, header->meshCount)
+            || !validIndex(node.texture, header->textureCount)
+            || !validIndex(node.normalMap, header->textureCount)
+            || !validIndex(node.roughnessMap, header->textureCount))
+        {
+            std::cerr << "Scene file " << filename << " has a malformed node at index " << i << std::endl;
+            return false;
+        }
+    }
+
+    // Resolve every mesh and texture once, nodes only refer to them by index
+    std::vector<int> meshVAOs(header->meshCount);
+    std::vector<unsigned int> meshIndexCounts(header->meshCount);
+    for (uint32_t i = 0; i < header->meshCount; i++) {
+        std::string name(strings + meshes[i].nameOffset, meshes[i].nameLength);
+        meshVAOs[i] = resources.loadMesh(name, meshIndexCounts[i]);
+    }
+
+    std::vector<unsigned int> textureIDs(header->textureCount);
+    for (uint32_t i = 0; i < header->textureCount; i++) {
+        std::string name(strings + textures[i].nameOffset, textures[i].nameLength);
+        textureIDs[i] = resources.loadTexture(name);
+    }
+
+    // Create the nodes straight from the mapped node table
+    std::vector<SceneNode*> created(header->nodeCount);
+    for (uint32_t i = 0; i < header->nodeCount; i++) {
+        const SceneFileNode &record = nodes[i];
+
+        SceneNode* node = createSceneNode();
+        node->nodeType   = SceneNodeType(record.nodeType);
+        node->materialID = record.materialID;
+        copyVec3(node->position, record.position);
+        copyVec3(node->rotation, record.rotation);
+        copyVec3(node->scale, record.scale);
+        copyVec3(node->referencePoint, record.referencePoint);
+        copyVec3(node->lightColor, record.lightColor);
+
+        if (record.mesh >= 0) {
+            node->vertexArrayObjectID = meshVAOs[record.mesh];
+            node->VAOIndexCount       = meshIndexCounts[record.mesh];
+        }
+        if (record.texture >= 0)      node->textureID      = textureIDs[record.texture];
+        if (record.normalMap >= 0)    node->normalMapID    = textureIDs[record.normalMap];
+        if (record.roughnessMap >= 0) node->roughnessMapID = textureIDs[record.roughnessMap];
+
+        if (record.parent >= 0) {
+            addChild(created[record.parent], node);
+        }
+        if (record.role != ROLE_NONE) {
+            scene.nodeByRole[record.role] = node;
+        }
+        created[i] = node;
+    }
+
+    scene.root = created[0];
+    scene.nodeCount = header->nodeCount;
+    return true;
+}
+
+namespace {
+    // Collects the tables of a scene file while walking the scene graph
+    struct SceneFileBuilder {
+        std::vector<SceneFileNode> nodes;
+        std::vector<SceneFileResource> meshes;
+        std::vector<SceneFileResource> textures;
+        std::string strings;
+
+        std::unordered_map<std::string, int32_t> meshIndexByName;
+        std::unordered_map<std::string, int32_t> textureIndexByName;
+
+        int32_t addResource(std::string const &name, std::vector<SceneFileResource> &table, std::unordered_map<std::string, int32_t> &indexByName) {
+            if (name.empty()) {
+                return -1;
+            }
+            auto it = indexByName.find(name);
+            if (it != indexByName.end()) {
+                return it->second;
+            }
+
+            SceneFileResource resource;
+            resource.nameOffset = uint32_t(strings.size());
+            resource.nameLength = uint32_t(name.size());
+            strings += name;
+
+            int32_t index = int32_t(table.size());
+            table.push_back(resource);
+            indexByName.insert({name, index});
+            return index;
+        }
+    };
+}
+
+static void collectNode(SceneFileBuilder &builder, SceneNode* node, int32_t parent,
+                        std::unordered_map<const SceneNode*, SceneNodeRole> const &roles,
+                        SceneResources const &resources)
+{
+    SceneFileNode record;
+    std::memset(&record, 0, sizeof(record));
+
+    record.parent     = parent;
+    record.nodeType   = node->nodeType;
+    record.materialID = node->materialID;
+
+    auto role = roles.find(node);
+    record.role = (role != roles.end()) ? role->second : ROLE_NONE;
+
+    copyVec3(record.position, node->position);
+    copyVec3(record.rotation, node->rotation);
+    copyVec3(record.scale, node->scale);
+    copyVec3(record.referencePoint, node->referencePoint);
+    copyVec3(record.lightColor, node->lightColor);
+
+    record.mesh = node->vertexArrayObjectID != -1
+        ? builder.addResource(resources.meshName(node->vertexArrayObjectID), builder.meshes, builder.meshIndexByName)
+        : -1;
+
+    auto texture = [&](unsigned int textureID) {
+        return textureID != 0
+            ? builder.addResource(resources.textureName(textureID), builder.textures, builder.textureIndexByName)
+            : -1;
+    };
+    record.texture      = texture(node->textureID);
+    record.normalMap    = texture(node->normalMapID);
+    record.roughnessMap = texture(node->roughnessMapID);
+
+    int32_t index = int32_t(builder.nodes.size());
+    builder.nodes.push_back(record);
+
+    for (SceneNode* child : node->children) {
+        collectNode(builder, child, index, roles, resources);
+    }
+}
+
+bool writeSceneFile(std::string const &filename, SceneNode* root,
+                    std::unordered_map<const SceneNode*, SceneNodeRole> const &roles,
+                    SceneResources const &resources)
+{
+    SceneFileBuilder builder;
+    collectNode(builder, root, -1, roles, resources);
+
+    SceneFileHeader header;
+    header.magic              = sceneFileMagic;
+    header.version            = sceneFileVersion;
+    header.nodeCount          = uint32_t(builder.nodes.size());
+    header.meshCount          = uint32_t(builder.meshes.size());
+    header.textureCount       = uint32_t(builder.textures.size());
+    header.stringTableSize    = uint32_t(builder.strings.size());
+    header.nodeTableOffset    = sizeof(SceneFileHeader);
+    header.meshTableOffset    = header.nodeTableOffset + header.nodeCount * sizeof(SceneFileNode);
+    header.textureTableOffset = header.meshTableOffset + header.meshCount * sizeof(SceneFileResource);
+    header.stringTableOffset  = header.textureTableOffset + header.textureCount * sizeof(SceneFileResource);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Could not open " << filename << " for writing" << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(builder.nodes.data()), builder.nodes.size() * sizeof(SceneFileNode));
+    file.write(reinterpret_cast<const char*>(builder.meshes.data()), builder.meshes.size() * sizeof(SceneFileResource));
+    file.write(reinterpret_cast<const char*>(builder.textures.data()), builder.textures.size() * sizeof(SceneFileResource));
+    file.write(builder.strings.data(), builder.strings.size());
+
+    return file.good();
+}
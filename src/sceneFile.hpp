@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include "sceneGraph.hpp"
+
+// Binary scene files (.glsc)
+//
+// The file is laid out so that it can be memory mapped and read in place, no text parsing involved:
+//
+//   SceneFileHeader
+//   SceneFileNode[nodeCount]          pre-order, every parent comes before its children
+//   SceneFileResource[meshCount]      mesh names, either "builtin:..." shapes, "text:..." or an OBJ path
+//   SceneFileResource[textureCount]   PNG texture paths
+//   char[stringTableSize]             the names referenced by the resource tables
+//
+// All fields are 4 bytes wide and little endian, so every table is 4 byte aligned.
+
+const uint32_t sceneFileMagic   = 0x43534C47; // "GLSC"
+const uint32_t sceneFileVersion = 1;
+
+// Nodes the game logic needs a handle to
+enum SceneNodeRole : uint32_t {
+    ROLE_NONE, ROLE_BOX, ROLE_PAD, ROLE_BALL, ROLE_TROPHY, ROLE_STRESS_ROOT, SCENE_ROLE_COUNT
+};
+
+struct SceneFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t stringTableSize;
+    uint32_t nodeTableOffset;
+    uint32_t meshTableOffset;
+    uint32_t textureTableOffset;
+    uint32_t stringTableOffset;
+};
+
+struct SceneFileNode {
+    int32_t  parent;            // -1 for the root node
+    uint32_t nodeType;          // SceneNodeType
+    uint32_t role;              // SceneNodeRole
+    uint32_t materialID;
+
+    float position[3];
+    float rotation[3];
+    float scale[3];
+    float referencePoint[3];
+    float lightColor[3];
+
+    int32_t mesh;               // index into the mesh table, -1 if none
+    int32_t texture;            // indices into the texture table, -1 if none
+    int32_t normalMap;
+    int32_t roughnessMap;
+};
+
+struct SceneFileResource {
+    uint32_t nameOffset;        // into the string table
+    uint32_t nameLength;
+};
+
+// Turn the names stored in a scene file into GPU resources and back
+struct SceneResources {
+    std::function<int(std::string const &name, unsigned int &indexCount)> loadMesh;
+    std::function<unsigned int(std::string const &name)> loadTexture;
+
+    std::function<std::string(int vertexArrayObjectID)> meshName;
+    std::function<std::string(unsigned int textureID)> textureName;
+};
+
+struct LoadedScene {
+    SceneNode* root = nullptr;
+    SceneNode* nodeByRole[SCENE_ROLE_COUNT] = {};
+    size_t nodeCount = 0;
+};
+
+// Memory maps the given scene file and creates its nodes. Returns false if the file is missing or malformed.
+bool loadSceneFile(std::string const &filename, SceneResources const &resources, LoadedScene &scene);
+
+// Writes the graph below `root` into a scene file
+bool writeSceneFile(std::string const &filename, SceneNode* root,
+                    std::unordered_map<const SceneNode*, SceneNodeRole> const &roles,
+                    SceneResources const &resources);
@@ -5,6 +5,14 @@ SceneNode* createSceneNode() {
 	return new SceneNode();
 }
 
+// Deletes the node and all of its children
+void deleteSceneNode(SceneNode* node) {
+	for (SceneNode* child : node->children) {
+		deleteSceneNode(child);
+	}
+	delete node;
+}
+
 // Add a child node to its parent's list of children
 void addChild(SceneNode* parent, SceneNode* child) {
 	parent->children.push_back(child);
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <utilities/bounds.h>
 
 #include <stack>
 #include <vector>
@@ -26,6 +27,7 @@ struct SceneNode {
 		scale = glm::vec3(1, 1, 1);
 
         referencePoint = glm::vec3(0, 0, 0);
+        lightColor = glm::vec3(0, 0, 0);
         vertexArrayObjectID = -1;
         VAOIndexCount = 0;
 
@@ -67,18 +69,24 @@ struct SceneNode {
 	// ID of the node
 	int id;
 
-	// for 2D or normal mapped geometry
-	unsigned int textureID;
+	// for 2D or normal mapped geometry, 0 if unused
+	unsigned int textureID = 0;
 
-	unsigned int normalMapID;
+	unsigned int normalMapID = 0;
 
-	unsigned int roughnessMapID;
+	unsigned int roughnessMapID = 0;
 
 	// ID of the material used for this node, 0 if the default material is used
 	unsigned int materialID = 0;
+
+	// Bounds of the node's mesh in local space (looked up on first use) and in world space (updated every frame)
+	AABB localBounds;
+	AABB worldBounds;
+	bool hasLocalBounds = false;
 };
 
 SceneNode* createSceneNode();
+void deleteSceneNode(SceneNode* node);
 void addChild(SceneNode* parent, SceneNode* child);
 void printNode(SceneNode* node);
 int totalChildren(SceneNode* parent);
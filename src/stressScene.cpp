@@ -0,0 +1,109 @@
+#include "stressScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Small xorshift generator, so that a seed gives the same scene on every platform and standard library
+    // (the distributions in <random> are implementation defined)
+    class SceneRandom {
+    public:
+        explicit SceneRandom(uint32_t seed) : state(seed * 747796405u + 2891336453u) {
+            if (state == 0) state = 1;
+        }
+
+        uint32_t next() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        // Uniform float in [low, high)
+        float uniform(float low, float high) {
+            return low + (high - low) * float(next() >> 8) * (1.0f / 16777216.0f);
+        }
+
+    private:
+        uint32_t state;
+    };
+
+    // Keep objects this far from the walls so that they don't poke through them
+    const float wallMargin = 2.0f;
+
+    const float minObjectSize = 4.0f;
+    const float maxObjectSize = 14.0f;
+}
+
+float unitScaleForMesh(Mesh const &mesh) {
+    if (mesh.vertices.empty()) {
+        return 1.0f;
+    }
+
+    glm::vec3 minCorner = mesh.vertices[0];
+    glm::vec3 maxCorner = mesh.vertices[0];
+    for (glm::vec3 const &vertex : mesh.vertices) {
+        minCorner = glm::min(minCorner, vertex);
+        maxCorner = glm::max(maxCorner, vertex);
+    }
+
+    glm::vec3 size = maxCorner - minCorner;
+    float largestAxis = std::max(size.x, std::max(size.y, size.z));
+    return largestAxis > 0.0f ? 1.0f / largestAxis : 1.0f;
+}
+
+void populateStressScene(SceneNode* parent, StressSceneParams const &params, StressSceneMeshes const &meshes, glm::vec3 halfExtent) {
+    SceneRandom random(params.seed);
+
+    const StressMesh* choices[3] = { &meshes.trophy, &meshes.sphere, &meshes.cube };
+
+    for (unsigned int i = 0; i < params.objectCount; i++) {
+        const StressMesh& mesh = *choices[random.next() % 3];
+
+        float size = random.uniform(minObjectSize, maxObjectSize);
+        glm::vec3 room = glm::max(halfExtent - glm::vec3(size / 2 + wallMargin), glm::vec3(0.0f));
+
+        SceneNode* node = createSceneNode();
+        node->nodeType            = GEOMETRY;
+        node->vertexArrayObjectID = mesh.vertexArrayObjectID;
+        node->VAOIndexCount       = mesh.indexCount;
+        node->position = glm::vec3(
+            random.uniform(-room.x, room.x),
+            random.uniform(-room.y, room.y),
+            random.uniform(-room.z, room.z)
+        );
+        node->rotation = glm::vec3(0, random.uniform(0.0f, 6.2831853f), 0);
+        node->scale    = glm::vec3(size * mesh.unitScale);
+
+        addChild(parent, node);
+    }
+
+    // Dim the lights as their number grows, so that the image doesn't just saturate to white
+    float intensity = 1.0f / std::sqrt(float(std::max(params.lightCount, 1u)));
+
+    for (unsigned int i = 0; i < params.lightCount; i++) {
+        glm::vec3 room = glm::max(halfExtent - glm::vec3(wallMargin), glm::vec3(0.0f));
+
+        SceneNode* lightNode = createSceneNode();
+        lightNode->nodeType = POINT_LIGHT;
+        lightNode->position = glm::vec3(
+            random.uniform(-room.x, room.x),
+            random.uniform(-room.y, room.y),
+            random.uniform(-room.z, room.z)
+        );
+        lightNode->lightColor = intensity * glm::vec3(
+            random.uniform(0.3f, 1.0f),
+            random.uniform(0.3f, 1.0f),
+            random.uniform(0.3f, 1.0f)
+        );
+
+        addChild(parent, lightNode);
+    }
+}
+
+void clearStressScene(SceneNode* parent) {
+    for (SceneNode* child : parent->children) {
+        deleteSceneNode(child);
+    }
+    parent->children.clear();
+}
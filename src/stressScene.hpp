@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utilities/mesh.h>
+#include "sceneGraph.hpp"
+
+// A mesh that the stress scene generator may instantiate
+struct StressMesh {
+    int vertexArrayObjectID = -1;
+    unsigned int indexCount = 0;
+
+    // Uniform scale that makes the mesh one unit across along its largest axis
+    float unitScale = 1.0f;
+};
+
+struct StressSceneMeshes {
+    StressMesh trophy;
+    StressMesh sphere;
+    StressMesh cube;
+};
+
+struct StressSceneParams {
+    unsigned int objectCount = 0;
+    unsigned int lightCount  = 0;
+    unsigned int seed        = 1;
+};
+
+// Returns the scale that makes the given mesh one unit across along its largest axis
+float unitScaleForMesh(Mesh const &mesh);
+
+// Fills the given parent node with a deterministic random arrangement of trophies, spheres, cubes and point lights.
+// The parent is expected to sit in the middle of the volume to fill, `halfExtent` is the half-size of that volume.
+void populateStressScene(SceneNode* parent, StressSceneParams const &params, StressSceneMeshes const &meshes, glm::vec3 halfExtent);
+
+// Deletes all children (and their subtrees) of the given node
+void clearStressScene(SceneNode* parent);
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "beatTimeline.hpp"
+
 // I recommend closing this file right now.
 // You'll only find despair here
 // And cries of "WHY"
 // Proceed at your own risk.
 
-const std::vector<double> keyFrameTimeStamps =
+constexpr double keyFrameTimeStamps[] =
         {0, 0.98,
 
          1.570, 2.102, // block 0
@@ -182,7 +184,7 @@ const std::vector<double> keyFrameTimeStamps =
          144.286, 144.367, 144.595,
 
          9999999};
-const std::vector<KeyFrameAction> keyFrameDirections =
+constexpr KeyFrameAction keyFrameDirections[] =
         {BOTTOM, TOP,
 
          BOTTOM, TOP, // Block 0
@@ -358,4 +360,7 @@ const std::vector<KeyFrameAction> keyFrameDirections =
 
          TOP, BOTTOM, TOP,
 
-         BOTTOM,};
\ No newline at end of file
+         BOTTOM,};
+
+static_assert(sizeof(keyFrameTimeStamps) / sizeof(keyFrameTimeStamps[0]) == sizeof(keyFrameDirections) / sizeof(keyFrameDirections[0]),
+              "Every key frame needs a direction");
@@ -0,0 +1,92 @@
+#include "triangleBinning.hpp"
+
+#include <algorithm>
+#include <string>
+#include <glm/gtc/type_ptr.hpp>
+#include <utilities/shader.hpp>
+
+// The passes of bin.comp, their values match BIN_STAGE in bin.comp
+enum BinStage {
+    BIN_COUNT = 1,  // counts the triangles of every tile
+    BIN_SCAN,       // turns the counts into list offsets
+    BIN_FILL        // writes the lists
+};
+
+static Gloom::Shader* countShader;
+static Gloom::Shader* scanShader;
+static Gloom::Shader* fillShader;
+
+static GLuint tileCountBuffer = 0;
+static GLuint tileRangeBuffer = 0;
+static GLuint tileListBuffer = 0;
+static size_t tileCapacity = 0;
+static size_t listCapacity = 0;
+
+// Room for this many list entries per triangle, tiles whose list doesn't fit test every triangle instead
+const size_t listEntriesPerTriangle = 16;
+
+static Gloom::Shader* loadStage(BinStage stage) {
+    Gloom::Shader* shader = new Gloom::Shader();
+    shader->attach("../res/shaders/bin.comp", {{"BIN_STAGE", std::to_string(int(stage))}});
+    shader->link();
+    return shader;
+}
+
+void initTriangleBinning() {
+    countShader = loadStage(BIN_COUNT);
+    scanShader  = loadStage(BIN_SCAN);
+    fillShader  = loadStage(BIN_FILL);
+
+    glGenBuffers(1, &tileCountBuffer);
+    glGenBuffers(1, &tileRangeBuffer);
+    glGenBuffers(1, &tileListBuffer);
+}
+
+void binTriangles(glm::mat4 const &viewProjection, glm::ivec2 traceSize, glm::ivec2 tileSize, int triangleCount) {
+    glm::ivec2 tileCount = (traceSize + tileSize - 1) / tileSize;
+    size_t tiles = size_t(tileCount.x) * size_t(tileCount.y);
+
+    // Only written by the GPU, grow but never shrink
+    if (tiles > tileCapacity) {
+        tileCapacity = tiles;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileCountBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileRangeBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, tileCapacity * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    }
+    size_t entries = std::max<size_t>(size_t(triangleCount) * listEntriesPerTriangle, 1);
+    if (entries > listCapacity) {
+        listCapacity = entries;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileListBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, listCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    // Last frame's fill pass may still be counting
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileCountBuffer);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, tiles * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, tileCountBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, tileRangeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, tileListBuffer);
+
+    for (Gloom::Shader* shader : {countShader, scanShader, fillShader}) {
+        shader->activate();
+        glUniform1i(shader->getUniformFromName("numTriangles"), triangleCount);
+        glUniformMatrix4fv(shader->getUniformFromName("viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform2i(shader->getUniformFromName("traceSize"), traceSize.x, traceSize.y);
+        glUniform2i(shader->getUniformFromName("tileSize"), tileSize.x, tileSize.y);
+        glUniform2i(shader->getUniformFromName("tileCount"), tileCount.x, tileCount.y);
+        glUniform1ui(shader->getUniformFromName("listCapacity"), GLuint(listCapacity));
+
+        // The scan runs as a single work group over all tiles, the others run one thread per triangle
+        if (shader == scanShader) {
+            glDispatchCompute(1, 1, 1);
+        } else {
+            glDispatchCompute(GLuint((triangleCount + 63) / 64), 1, 1);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    glUseProgram(0);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Bins the ray tracer's triangles into per-tile lists on the GPU, so that the primary rays of a tile only test the
+// triangles whose screen space bounds overlap it. A tile is as large as one ray tracer work group.
+
+void initTriangleBinning();
+
+// Bins the `triangleCount` triangles bound to shader storage binding 1, as seen through `viewProjection` in an image
+// of `traceSize` pixels, and leaves the tile ranges and lists bound to bindings 10 and 11 for the ray tracer
+void binTriangles(glm::mat4 const &viewProjection, glm::ivec2 traceSize, glm::ivec2 tileSize, int triangleCount);
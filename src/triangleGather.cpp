@@ -0,0 +1,129 @@
+#include "triangleGather.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GATHER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Triangles per work item, large enough to keep the scheduling overhead out of the profile
+    const size_t trianglesPerRange = 2048;
+
+#ifdef GATHER_USE_SSE
+    // Matrix columns kept in registers for a whole job. The normal matrix columns have w = 0, so that
+    // transformed normals do too, which the normalization below relies on.
+    struct SimdTransform {
+        __m128 model[4];
+        __m128 normal[3];
+
+        explicit SimdTransform(GatherJob const &job) {
+            for (int i = 0; i < 4; i++) {
+                model[i] = _mm_loadu_ps(&job.modelMatrix[i][0]);
+            }
+            for (int i = 0; i < 3; i++) {
+                normal[i] = _mm_setr_ps(job.normalMatrix[i][0], job.normalMatrix[i][1], job.normalMatrix[i][2], 0.0f);
+            }
+        }
+
+        __m128 point(glm::vec3 const &p) const {
+            __m128 r = _mm_add_ps(_mm_mul_ps(model[0], _mm_set1_ps(p.x)), model[3]);
+            r = _mm_add_ps(r, _mm_mul_ps(model[1], _mm_set1_ps(p.y)));
+            return _mm_add_ps(r, _mm_mul_ps(model[2], _mm_set1_ps(p.z)));
+        }
+
+        __m128 direction(glm::vec3 const &n) const {
+            __m128 r = _mm_mul_ps(normal[0], _mm_set1_ps(n.x));
+            r = _mm_add_ps(r, _mm_mul_ps(normal[1], _mm_set1_ps(n.y)));
+            r = _mm_add_ps(r, _mm_mul_ps(normal[2], _mm_set1_ps(n.z)));
+
+            // Horizontal sum of the squares into every lane, then normalize
+            __m128 squares = _mm_mul_ps(r, r);
+            __m128 sum = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            return _mm_div_ps(r, _mm_sqrt_ps(sum));
+        }
+    };
+
+    // The vec3 + padding pairs of a Triangle are 16 bytes each, so a whole register is stored at once.
+    // This writes the transformed w into the padding, which the shader never reads.
+    void transformRange(GatherJob const &job, size_t begin, size_t end, Triangle* output) {
+        const Mesh &mesh = *job.mesh;
+        const SimdTransform transform(job);
+        const bool hasNormals = !mesh.normals.empty();
+        const __m128 zero = _mm_setzero_ps();
+
+        for (size_t t = begin; t < end; t++) {
+            unsigned int i0 = mesh.indices[3 * t + 0];
+            unsigned int i1 = mesh.indices[3 * t + 1];
+            unsigned int i2 = mesh.indices[3 * t + 2];
+
+            Triangle &tri = output[t];
+            _mm_storeu_ps(&tri.v0.x, transform.point(mesh.vertices[i0]));
+            _mm_storeu_ps(&tri.v1.x, transform.point(mesh.vertices[i1]));
+            _mm_storeu_ps(&tri.v2.x, transform.point(mesh.vertices[i2]));
+
+            if (hasNormals) {
+                _mm_storeu_ps(&tri.n0.x, transform.direction(mesh.normals[i0]));
+                _mm_storeu_ps(&tri.n1.x, transform.direction(mesh.normals[i1]));
+                _mm_storeu_ps(&tri.n2.x, transform.direction(mesh.normals[i2]));
+            } else {
+                _mm_storeu_ps(&tri.n0.x, zero);
+                _mm_storeu_ps(&tri.n1.x, zero);
+                _mm_storeu_ps(&tri.n2.x, zero);
+            }
+
+            tri.materialID = job.materialID;
+        }
+    }
+#else
+    void transformRange(GatherJob const &job, size_t begin, size_t end, Triangle* output) {
+        const Mesh &mesh = *job.mesh;
+        const bool hasNormals = !mesh.normals.empty();
+
+        for (size_t t = begin; t < end; t++) {
+            unsigned int i0 = mesh.indices[3 * t + 0];
+            unsigned int i1 = mesh.indices[3 * t + 1];
+            unsigned int i2 = mesh.indices[3 * t + 2];
+
+            Triangle &tri = output[t];
+            tri.v0 = glm::vec3(job.modelMatrix * glm::vec4(mesh.vertices[i0], 1.0));
+            tri.v1 = glm::vec3(job.modelMatrix * glm::vec4(mesh.vertices[i1], 1.0));
+            tri.v2 = glm::vec3(job.modelMatrix * glm::vec4(mesh.vertices[i2], 1.0));
+
+            if (hasNormals) {
+                tri.n0 = glm::normalize(job.normalMatrix * mesh.normals[i0]);
+                tri.n1 = glm::normalize(job.normalMatrix * mesh.normals[i1]);
+                tri.n2 = glm::normalize(job.normalMatrix * mesh.normals[i2]);
+            } else {
+                tri.n0 = tri.n1 = tri.n2 = glm::vec3(0.0f);
+            }
+
+            tri.materialID = job.materialID;
+        }
+    }
+#endif
+}
+
+void transformTriangles(std::vector<GatherJob> const &jobs, Triangle* output, ThreadPool &pool) {
+    if (jobs.empty()) {
+        return;
+    }
+    size_t total = jobs.back().firstTriangle + triangleCount(*jobs.back().mesh);
+
+    // Ranges are cut over the whole output rather than per job, so one big mesh still spreads over every thread
+    pool.parallelFor(total, trianglesPerRange, [&](size_t begin, size_t end) {
+        // Last job starting at or before `begin`
+        auto job = std::upper_bound(jobs.begin(), jobs.end(), begin, [](size_t index, GatherJob const &j) {
+            return index < j.firstTriangle;
+        }) - 1;
+
+        while (begin < end) {
+            size_t jobEnd = std::min(end, job->firstTriangle + triangleCount(*job->mesh));
+            transformRange(*job, begin - job->firstTriangle, jobEnd - job->firstTriangle, output + job->firstTriangle);
+            begin = jobEnd;
+            ++job;
+        }
+    });
+}
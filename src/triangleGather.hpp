@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <utilities/mesh.h>
+#include <utilities/threadPool.hpp>
+
+struct Triangle {
+    // vec3 + padding to align to 16 bytes due to std140 layout
+    // v is world space vertex, n is normal
+    glm::vec3 v0; float pad0;
+    glm::vec3 v1; float pad1;
+    glm::vec3 v2; float pad2;
+    glm::vec3 n0; float pad3;
+    glm::vec3 n1; float pad4;
+    glm::vec3 n2; float pad5;
+    unsigned int materialID; float pad6; float pad7; float pad8;
+};
+
+// One mesh instance whose triangles go into the gathered triangle array
+struct GatherJob {
+    const Mesh* mesh;
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix;
+    unsigned int materialID;
+
+    // Index of the instance's first triangle in the output, the running sum of the triangle counts before it
+    size_t firstTriangle;
+};
+
+// Number of triangles a mesh contributes
+inline size_t triangleCount(Mesh const &mesh) {
+    return mesh.indices.size() / 3;
+}
+
+// Transforms the triangles of all jobs to world space, writing each into its slot of `output`.
+// `output` must hold at least the total triangle count of the jobs. The work is spread over `pool`.
+void transformTriangles(std::vector<GatherJob> const &jobs, Triangle* output, ThreadPool &pool);
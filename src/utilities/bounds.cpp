@@ -0,0 +1,105 @@
+#include "bounds.h"
+
+#include <cmath>
+
+AABB computeBounds(std::vector<glm::vec3> const &points) {
+    AABB bounds;
+    for (glm::vec3 const &point : points) {
+        expandBounds(bounds, point);
+    }
+    return bounds;
+}
+
+void expandBounds(AABB &bounds, glm::vec3 point) {
+    bounds.min = glm::min(bounds.min, point);
+    bounds.max = glm::max(bounds.max, point);
+}
+
+void expandBounds(AABB &bounds, AABB const &other) {
+    if (other.isEmpty()) {
+        return;
+    }
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+}
+
+AABB transformBounds(AABB const &bounds, glm::mat4 const &transform) {
+    if (bounds.isEmpty()) {
+        return bounds;
+    }
+
+    // Transform the center, and grow the extent by the absolute value of the rotation/scale part (Arvo's method)
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+    glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtent(0.0f);
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            worldExtent[row] += std::abs(transform[column][row]) * extent[column];
+        }
+    }
+
+    AABB result;
+    result.min = worldCenter - worldExtent;
+    result.max = worldCenter + worldExtent;
+    return result;
+}
+
+bool boundsOverlap(AABB const &a, AABB const &b) {
+    return !a.isEmpty() && !b.isEmpty()
+        && a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool containsBounds(AABB const &outer, AABB const &inner) {
+    return inner.isEmpty()
+        || (inner.min.x >= outer.min.x && inner.max.x <= outer.max.x
+            && inner.min.y >= outer.min.y && inner.max.y <= outer.max.y
+            && inner.min.z >= outer.min.z && inner.max.z <= outer.max.z);
+}
+
+AABB clipBounds(AABB const &bounds, AABB const &clip) {
+    AABB clipped;
+    if (boundsOverlap(bounds, clip)) {
+        clipped.min = glm::max(bounds.min, clip.min);
+        clipped.max = glm::min(bounds.max, clip.max);
+    }
+    return clipped;
+}
+
+Frustum extractFrustum(glm::mat4 const &viewProjection) {
+    // Gribb & Hartmann, rows of the (column major) matrix combined pairwise
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0); // left
+    frustum.planes[1] = row(3) - row(0); // right
+    frustum.planes[2] = row(3) + row(1); // bottom
+    frustum.planes[3] = row(3) - row(1); // top
+    frustum.planes[4] = row(3) + row(2); // near
+    frustum.planes[5] = row(3) - row(2); // far
+    return frustum;
+}
+
+bool intersectsFrustum(Frustum const &frustum, AABB const &bounds) {
+    if (bounds.isEmpty()) {
+        return false;
+    }
+
+    for (glm::vec4 const &plane : frustum.planes) {
+        // The corner furthest along the plane normal, if even that one is outside, the whole box is
+        glm::vec3 corner(
+            plane.x >= 0 ? bounds.max.x : bounds.min.x,
+            plane.y >= 0 ? bounds.max.y : bounds.min.y,
+            plane.z >= 0 ? bounds.max.z : bounds.min.z
+        );
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box. A default constructed box is empty and contains nothing.
+struct AABB {
+    glm::vec3 min = glm::vec3( 1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+};
+
+// The six planes of a view frustum, as (normal, distance) with normals pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Bounding box of all the given points
+AABB computeBounds(std::vector<glm::vec3> const &points);
+
+// Grows the box so that it also contains the given point or box
+void expandBounds(AABB &bounds, glm::vec3 point);
+void expandBounds(AABB &bounds, AABB const &other);
+
+// Bounding box of the given box after transforming it by the given matrix
+AABB transformBounds(AABB const &bounds, glm::mat4 const &transform);
+
+bool boundsOverlap(AABB const &a, AABB const &b);
+
+// Whether `inner` lies entirely inside `outer`. An empty `inner` lies inside anything.
+bool containsBounds(AABB const &outer, AABB const &inner);
+
+// The part of the box that is also inside `clip`, empty if they don't overlap
+AABB clipBounds(AABB const &bounds, AABB const &clip);
+
+// Extracts the frustum planes from a view-projection matrix (OpenGL clip space)
+Frustum extractFrustum(glm::mat4 const &viewProjection);
+
+// Conservative test, may report boxes near the frustum corners as visible
+bool intersectsFrustum(Frustum const &frustum, AABB const &bounds);
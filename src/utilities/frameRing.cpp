@@ -0,0 +1,177 @@
+#include "frameRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+static bool persistent = false;
+static GLuint ringBuffer = 0;
+static unsigned char* ringMemory = nullptr;
+static std::vector<unsigned char> clientMemory;
+
+static size_t slotSize = 0;
+static int currentSlot = 0;
+static size_t slotCursor = 0;
+static GLsync slotFences[frameRingSlots] = {};
+
+// Where the current frame's allocations would end if they had all fit, every request advances it
+static size_t demandCursor = 0;
+
+// Largest amount any frame asked for, including what did not fit
+static size_t peakDemand = 0;
+
+static GLint storageAlignment = 256;
+static GLint uniformAlignment = 256;
+
+// Buffers for data that didn't fit, by binding point. They're only needed until the ring has grown.
+static std::map<std::pair<GLenum, GLuint>, GLuint> overflowBuffers;
+
+static void waitForSlot(int slot) {
+    if (!slotFences[slot]) {
+        return;
+    }
+
+    // Flush on the first wait so that the fence is guaranteed to signal
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum result = glClientWaitSync(slotFences[slot], flags, 1000000000);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+
+    glDeleteSync(slotFences[slot]);
+    slotFences[slot] = nullptr;
+}
+
+static void createRingBuffer(size_t bytesPerFrame) {
+    slotSize = bytesPerFrame;
+    size_t totalSize = slotSize * frameRingSlots;
+
+    glGenBuffers(1, &ringBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ringBuffer);
+
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+        ringMemory = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+        clientMemory.assign(totalSize, 0);
+        ringMemory = clientMemory.data();
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+static void destroyRingBuffer() {
+    for (int slot = 0; slot < frameRingSlots; slot++) {
+        waitForSlot(slot);
+    }
+
+    if (persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ringBuffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &ringBuffer);
+    ringBuffer = 0;
+    ringMemory = nullptr;
+}
+
+void initFrameRing(size_t bytesPerFrame) {
+    persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+    if (!persistent) {
+        std::cout << "Persistent buffer mapping not supported, frame data is copied with glBufferSubData" << std::endl;
+    }
+
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
+    createRingBuffer(bytesPerFrame);
+}
+
+void beginFrameRing() {
+    currentSlot = (currentSlot + 1) % frameRingSlots;
+
+    // Grow while nothing is being written, so that no allocation of a frame ever moves
+    if (peakDemand > slotSize) {
+        destroyRingBuffer();
+        createRingBuffer(peakDemand + peakDemand / 2);
+    }
+
+    waitForSlot(currentSlot);
+    slotCursor = 0;
+    demandCursor = 0;
+
+    for (auto &overflow : overflowBuffers) {
+        glDeleteBuffers(1, &overflow.second);
+    }
+    overflowBuffers.clear();
+}
+
+void endFrameRing() {
+    slotFences[currentSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+FrameAllocation allocateFrameData(GLenum target, size_t size) {
+    size_t alignment = size_t(target == GL_UNIFORM_BUFFER ? uniformAlignment : storageAlignment);
+
+    // Binding an empty range is an error, so nothing is ever smaller than one alignment unit
+    size = std::max(size, alignment);
+    size_t offset = (slotCursor + alignment - 1) / alignment * alignment;
+
+    demandCursor = (demandCursor + alignment - 1) / alignment * alignment + size;
+    peakDemand = std::max(peakDemand, demandCursor);
+
+    FrameAllocation allocation;
+    allocation.size = GLsizeiptr(size);
+    if (offset + size > slotSize) {
+        return allocation;
+    }
+
+    slotCursor = offset + size;
+    allocation.offset = GLintptr(currentSlot * slotSize + offset);
+    allocation.data = ringMemory + allocation.offset;
+    return allocation;
+}
+
+void bindFrameData(GLenum target, GLuint index, FrameAllocation const &allocation) {
+    if (!persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ringBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, ringMemory + allocation.offset);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glBindBufferRange(target, index, ringBuffer, allocation.offset, allocation.size);
+}
+
+void uploadFrameData(GLenum target, GLuint index, const void* data, size_t size) {
+    FrameAllocation allocation = allocateFrameData(target, size);
+    if (allocation.data) {
+        if (size > 0) {
+            std::memcpy(allocation.data, data, size);
+        }
+        bindFrameData(target, index, allocation);
+        return;
+    }
+
+    GLuint &overflow = overflowBuffers[{target, index}];
+    if (!overflow) {
+        glGenBuffers(1, &overflow);
+    }
+    glBindBuffer(target, overflow);
+    glBufferData(target, allocation.size, nullptr, GL_STREAM_DRAW);
+    if (size > 0) {
+        glBufferSubData(target, 0, size, data);
+    }
+    glBindBufferBase(target, index, overflow);
+    glBindBuffer(target, 0);
+}
+
+size_t frameRingUsage() {
+    return demandCursor;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Ring allocator for data that only lives for one frame (triangles, lights, camera, materials, instances).
+//
+// One buffer is split into frameRingSlots slots, each frame suballocates from its own slot and the slot is only
+// reused once a fence says the GPU is done with it. With ARB_buffer_storage the buffer is mapped once, persistently
+// and coherently, so writes go straight to memory the GPU reads and the driver never reallocates anything.
+// Without it, the slots live in client memory and are copied over with glBufferSubData when bound.
+
+const int frameRingSlots = 3;
+
+struct FrameAllocation {
+    void* data = nullptr;      // where to write, nullptr if the ring was full
+    GLintptr offset = 0;       // into the ring buffer
+    GLsizeiptr size = 0;
+};
+
+void initFrameRing(size_t bytesPerFrame);
+
+// Start writing the next frame, waits until the GPU is done with the slot if needed
+void beginFrameRing();
+
+// Fences everything submitted since beginFrameRing()
+void endFrameRing();
+
+// Reserves `size` bytes aligned for binding to `target` (GL_SHADER_STORAGE_BUFFER or GL_UNIFORM_BUFFER).
+// Returns an allocation without data if the slot is full, the ring then grows at the start of the next frame.
+FrameAllocation allocateFrameData(GLenum target, size_t size);
+
+// Binds a filled allocation to an indexed binding point of `target`
+void bindFrameData(GLenum target, GLuint index, FrameAllocation const &allocation);
+
+// Copies `data` into the ring and binds it. Falls back to a buffer of its own for the frame when the ring is full.
+void uploadFrameData(GLenum target, GLuint index, const void* data, size_t size);
+
+// Bytes the current frame asked for so far, including what did not fit
+size_t frameRingUsage();
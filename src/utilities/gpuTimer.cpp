@@ -0,0 +1,47 @@
+#include "gpuTimer.hpp"
+
+GpuTimer::GpuTimer() {
+    glGenQueries(queryCount, mQueries);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(queryCount, mQueries);
+}
+
+void GpuTimer::begin() {
+    // Every query is still waiting to be read, skip this measurement rather than reuse one of them
+    if (mPendingCount == queryCount) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, mQueries[mNextQuery]);
+    mRunning = true;
+}
+
+void GpuTimer::end() {
+    if (!mRunning) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    mRunning = false;
+    mNextQuery = (mNextQuery + 1) % queryCount;
+    mPendingCount++;
+}
+
+bool GpuTimer::read(double &milliseconds) {
+    if (mPendingCount == 0) {
+        return false;
+    }
+
+    GLuint oldest = mQueries[(mNextQuery - mPendingCount + queryCount) % queryCount];
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return false;
+    }
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &elapsedNs);
+    mPendingCount--;
+    milliseconds = elapsedNs / 1e6;
+    return true;
+}
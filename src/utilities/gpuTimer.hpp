@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Measures how long the GPU takes for the commands between begin() and end(), without stalling.
+// Results are read back a few frames late, once the GPU has got to them.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    // Measurements are skipped while every query still waits for read()
+    void begin();
+    void end();
+
+    // The oldest measurement that has finished since the last call. Returns false if there is none yet.
+    bool read(double &milliseconds);
+
+private:
+    // Disable copying and assignment
+    GpuTimer(GpuTimer const &) = delete;
+    GpuTimer & operator =(GpuTimer const &) = delete;
+
+    static const int queryCount = 4;
+
+    GLuint mQueries[queryCount];
+    int mNextQuery = 0;     // started next
+    int mPendingCount = 0;  // ended but not read yet
+    bool mRunning = false;
+};
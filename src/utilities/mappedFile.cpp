@@ -0,0 +1,80 @@
+#include "mappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const &filename) {
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    mFileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        return;
+    }
+    mMappingHandle = mapping;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        return;
+    }
+
+    mData = static_cast<const unsigned char*>(view);
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if (mData != nullptr)        UnmapViewOfFile(mData);
+    if (mMappingHandle != nullptr) CloseHandle(mMappingHandle);
+    if (mFileHandle != nullptr)  CloseHandle(mFileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(std::string const &filename) {
+    mFileDescriptor = open(filename.c_str(), O_RDONLY);
+    if (mFileDescriptor < 0) {
+        return;
+    }
+
+    struct stat fileInfo;
+    if (fstat(mFileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0) {
+        return;
+    }
+
+    void* view = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+    if (view == MAP_FAILED) {
+        return;
+    }
+
+    mData = static_cast<const unsigned char*>(view);
+    mSize = static_cast<size_t>(fileInfo.st_size);
+}
+
+MappedFile::~MappedFile() {
+    if (mData != nullptr) {
+        munmap(const_cast<unsigned char*>(mData), mSize);
+    }
+    if (mFileDescriptor >= 0) {
+        close(mFileDescriptor);
+    }
+}
+
+#endif
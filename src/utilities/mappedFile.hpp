@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping is released when the object goes out of scope.
+class MappedFile {
+public:
+    explicit MappedFile(std::string const &filename);
+    ~MappedFile();
+
+    bool isOpen() const { return mData != nullptr; }
+    const unsigned char* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    // Disable copying and assignment
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator =(MappedFile const &) = delete;
+
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+
+#ifdef _WIN32
+    void* mFileHandle = nullptr;
+    void* mMappingHandle = nullptr;
+#else
+    int mFileDescriptor = -1;
+#endif
+};
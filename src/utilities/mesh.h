@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <glm/glm.hpp>
+#include "bounds.h"
 
 struct Mesh {
     std::vector<glm::vec3> vertices;
@@ -12,4 +13,7 @@ struct Mesh {
     std::vector<glm::vec3> bitangents;
 
     std::vector<unsigned int> indices;
+
+    // Local space bounding box of the vertices, see computeBounds()
+    AABB bounds;
 };
\ No newline at end of file
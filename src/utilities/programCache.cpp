@@ -0,0 +1,133 @@
+#include "programCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "mappedFile.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    const uint32_t programBinaryMagic   = 0x42504C47; // "GLPB"
+    const uint32_t programBinaryVersion = 1;
+
+    struct ProgramBinaryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    std::string cachePath(uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return programCacheDirectory + "/" + name;
+    }
+
+    std::string glString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+    bool binaryFormatsSupported() {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        return formatCount > 0;
+    }
+}
+
+uint64_t programCacheSeed() {
+    // 64 bit FNV-1a offset basis
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = programCacheHash(key, glString(GL_VENDOR));
+    key = programCacheHash(key, glString(GL_RENDERER));
+    key = programCacheHash(key, glString(GL_VERSION));
+    return key;
+}
+
+uint64_t programCacheHash(uint64_t key, std::string const &text) {
+    for (unsigned char c : text) {
+        key = (key ^ c) * 0x100000001b3ull;
+    }
+    // Separate consecutive strings, so that "ab" + "c" and "a" + "bc" differ
+    return (key ^ 0xff) * 0x100000001b3ull;
+}
+
+bool loadProgramBinary(GLuint program, uint64_t key) {
+    if (!binaryFormatsSupported()) {
+        return false;
+    }
+
+    MappedFile file(cachePath(key));
+    if (!file.isOpen() || file.size() < sizeof(ProgramBinaryHeader)) {
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != programBinaryMagic || header.version != programBinaryVersion
+        || header.binaryLength != file.size() - sizeof(ProgramBinaryHeader))
+    {
+        return false;
+    }
+
+    glProgramBinary(program, header.binaryFormat, file.data() + sizeof(ProgramBinaryHeader), GLsizei(header.binaryLength));
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+bool saveProgramBinary(GLuint program, uint64_t key) {
+    if (!binaryFormatsSupported()) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+#ifdef _WIN32
+    _mkdir(programCacheDirectory.c_str());
+#else
+    mkdir(programCacheDirectory.c_str(), 0755);
+#endif
+
+    std::string path = cachePath(key);
+    std::ofstream file(path, std::ios::binary);
+    if (file.fail()) {
+        fprintf(stderr, "Could not write the shader cache file \"%s\".\n", path.c_str());
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    header.magic        = programBinaryMagic;
+    header.version      = programBinaryVersion;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = uint32_t(length);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    return file.good();
+}
+
+bool enableParallelShaderCompile() {
+    static bool enabled = false;
+    if (!enabled && GLAD_GL_KHR_parallel_shader_compile) {
+        // Let the driver pick how many threads to use
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        enabled = true;
+    }
+    return enabled;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked shader programs (glGetProgramBinary / glProgramBinary)
+//
+// Every program is stored in its own file below programCacheDirectory, named after a hash of its shader
+// sources and the driver's vendor, renderer and version strings. A driver update thus simply misses the cache.
+
+const std::string programCacheDirectory = "shadercache";
+
+// Starts a cache key, seeded with the driver strings
+uint64_t programCacheSeed();
+
+// Mixes a string (a shader source, say) into a cache key
+uint64_t programCacheHash(uint64_t key, std::string const &text);
+
+// Loads the program stored under `key` into `program`. Returns false if there is none or the driver rejects it.
+bool loadProgramBinary(GLuint program, uint64_t key);
+
+// Stores the linked `program` under `key`
+bool saveProgramBinary(GLuint program, uint64_t key);
+
+// Lets the driver compile and link on its own threads, if it supports GL_KHR_parallel_shader_compile.
+// Returns whether it does.
+bool enableParallelShaderCompile();
@@ -5,15 +5,23 @@
 // System headers
 #include <glad/glad.h>
 
+// Local headers
+#include "programCache.hpp"
+
 // Standard headers
 #include <cassert>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 
 namespace Gloom
 {
+    // Preprocessor definitions (name, value) injected into a shader's source
+    typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
     class Shader
     {
     private:
@@ -23,6 +31,16 @@ namespace Gloom
         GLint  mStatus;
         GLint  mLength;
 
+        // Sources attached since the last link, compiled only if the program isn't in the cache
+        struct ShaderSource {
+            std::string filename;
+            std::string source;
+        };
+        std::vector<ShaderSource> mSources;
+        std::vector<GLuint> mShaders;
+        uint64_t mCacheKey = 0;
+        bool mLoadedFromCache = false;
+
     public:
         Shader() {
             mProgram = glCreateProgram();
@@ -34,8 +52,11 @@ namespace Gloom
         GLuint get()        { return mProgram; }
         void   destroy()    { glDeleteProgram(mProgram); }
 
-        /* Attach a shader to the current shader program */
-        void attach(std::string const &filename)
+        /* Attach a shader to the current shader program. The source is only
+           read here, it is compiled when the program is linked. The given
+           defines are inserted right after the #version line, so every set
+           of defines compiles (and is cached) as its own program. */
+        void attach(std::string const &filename, ShaderDefines const &defines = {})
         {
             // Load GLSL Shader from source
             std::ifstream fd(filename.c_str());
@@ -50,37 +71,91 @@ namespace Gloom
             auto src = std::string(std::istreambuf_iterator<char>(fd),
                                   (std::istreambuf_iterator<char>()));
 
-            // Create shader object
-            const char * source = src.c_str();
-            auto shader = create(filename);
-            glShaderSource(shader, 1, &source, nullptr);
-            glCompileShader(shader);
-
-            // Display errors
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &mStatus);
-            if (!mStatus)
+            if (!defines.empty())
             {
-                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &mLength);
-                std::unique_ptr<char[]> buffer(new char[mLength]);
-                glGetShaderInfoLog(shader, mLength, nullptr, buffer.get());
-                fprintf(stderr, "%s\n%s", filename.c_str(), buffer.get());
+                std::string definitions;
+                for (auto const &define : defines)
+                    definitions += "#define " + define.first + " " + define.second + "\n";
+
+                // #version has to stay the first line, #line keeps the line
+                // numbers in compile errors matching the file
+                auto versionEnd = src.find('\n', src.find("#version"));
+                auto insertAt   = versionEnd == std::string::npos ? src.size() : versionEnd + 1;
+                src.insert(insertAt, definitions + "#line 2\n");
             }
 
-            assert(mStatus);
-
-            // Attach shader and free allocated memory
-            glAttachShader(mProgram, shader);
-            glDeleteShader(shader);
+            mSources.push_back({ filename, src });
         }
 
 
         /* Links all attached shaders together into a shader program */
         void link()
         {
-            // Link all attached shaders
+            startLink();
+            finishLink();
+        }
+
+
+        /* Starts linking without waiting for the result. The program is
+           loaded from the shader cache if it is in there, otherwise its
+           shaders are compiled and linked, on the driver's own threads if
+           it supports GL_KHR_parallel_shader_compile. Start several
+           programs before finishing any to have them compile in parallel. */
+        void startLink()
+        {
+            enableParallelShaderCompile();
+
+            mCacheKey = programCacheSeed();
+            for (auto const &shaderSource : mSources)
+                mCacheKey = programCacheHash(mCacheKey, shaderSource.filename + "\n" + shaderSource.source);
+
+            mLoadedFromCache = loadProgramBinary(mProgram, mCacheKey);
+            if (mLoadedFromCache)
+                return;
+
+            // Create and compile the shader objects, without asking for the
+            // compile status, which would wait for the compiler
+            for (auto const &shaderSource : mSources)
+            {
+                const char * source = shaderSource.source.c_str();
+                auto shader = create(shaderSource.filename);
+                glShaderSource(shader, 1, &source, nullptr);
+                glCompileShader(shader);
+                glAttachShader(mProgram, shader);
+                mShaders.push_back(shader);
+            }
+
+            glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
             glLinkProgram(mProgram);
+        }
 
-            // Display errors
+
+        /* Waits for a link started with startLink() and stores the program
+           in the shader cache */
+        void finishLink()
+        {
+            if (mLoadedFromCache)
+            {
+                mSources.clear();
+                return;
+            }
+
+            // Display compile errors
+            for (size_t i = 0; i < mShaders.size(); i++)
+            {
+                glGetShaderiv(mShaders[i], GL_COMPILE_STATUS, &mStatus);
+                if (!mStatus)
+                {
+                    glGetShaderiv(mShaders[i], GL_INFO_LOG_LENGTH, &mLength);
+                    std::unique_ptr<char[]> buffer(new char[mLength]);
+                    glGetShaderInfoLog(mShaders[i], mLength, nullptr, buffer.get());
+                    fprintf(stderr, "%s\n%s", mSources[i].filename.c_str(), buffer.get());
+                }
+
+                assert(mStatus);
+            }
+
+            // Display link errors
             glGetProgramiv(mProgram, GL_LINK_STATUS, &mStatus);
             if (!mStatus)
             {
@@ -91,6 +166,29 @@ namespace Gloom
             }
 
             assert(mStatus);
+
+            // Free the shader objects, the linked program keeps what it needs
+            for (GLuint shader : mShaders)
+            {
+                glDetachShader(mProgram, shader);
+                glDeleteShader(shader);
+            }
+            mShaders.clear();
+            mSources.clear();
+
+            if (mStatus)
+                saveProgramBinary(mProgram, mCacheKey);
+        }
+
+
+        /* Convenience function that attaches a vertex and a fragment shader
+           and starts linking them, finish with finishLink() */
+        void startBasicShader(std::string const &vertexFilename,
+                              std::string const &fragmentFilename)
+        {
+            attach(vertexFilename);
+            attach(fragmentFilename);
+            startLink();
         }
 
 
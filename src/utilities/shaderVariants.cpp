@@ -0,0 +1,39 @@
+#include "shaderVariants.hpp"
+
+ShaderVariants::ShaderVariants(std::vector<std::string> filenames)
+    : mFilenames(std::move(filenames)) {}
+
+ShaderVariants::Variant &ShaderVariants::variant(Gloom::ShaderDefines const &defines) {
+    std::string key;
+    for (auto const &define : defines) {
+        key += define.first + "=" + define.second + ";";
+    }
+
+    auto it = mVariants.find(key);
+    if (it != mVariants.end()) {
+        return it->second;
+    }
+
+    Variant created;
+    created.shader = new Gloom::Shader();
+    created.linked = false;
+    for (std::string const &filename : mFilenames) {
+        created.shader->attach(filename, defines);
+    }
+    created.shader->startLink();
+
+    return mVariants.insert({key, created}).first->second;
+}
+
+void ShaderVariants::prepare(Gloom::ShaderDefines const &defines) {
+    variant(defines);
+}
+
+Gloom::Shader* ShaderVariants::get(Gloom::ShaderDefines const &defines) {
+    Variant &found = variant(defines);
+    if (!found.linked) {
+        found.shader->finishLink();
+        found.linked = true;
+    }
+    return found.shader;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader.hpp"
+
+// One shader program compiled once for every combination of #defines it is used with. Each variant goes
+// through the program cache on its own, so only the first launch pays for compiling it.
+class ShaderVariants {
+public:
+    // `filenames` are attached in this order to every variant
+    explicit ShaderVariants(std::vector<std::string> filenames);
+
+    // Starts compiling a variant ahead of its first use
+    void prepare(Gloom::ShaderDefines const &defines);
+
+    // Returns the linked variant with the given defines, compiling it if nobody asked for it before
+    Gloom::Shader* get(Gloom::ShaderDefines const &defines);
+
+    size_t size() const { return mVariants.size(); }
+
+private:
+    struct Variant {
+        Gloom::Shader* shader;
+        bool linked;
+    };
+
+    Variant &variant(Gloom::ShaderDefines const &defines);
+
+    std::vector<std::string> mFilenames;
+    std::unordered_map<std::string, Variant> mVariants;
+};
@@ -0,0 +1,85 @@
+#include "threadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int workerCount) : nextIndex(0) {
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t elementCount, size_t grain, std::function<void(size_t, size_t)> const &loopBody) {
+    if (elementCount == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+
+    // Not worth waking anyone up for
+    if (workers.empty() || elementCount <= grain) {
+        loopBody(0, elementCount);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = &loopBody;
+        count = elementCount;
+        grainSize = grain;
+        nextIndex = 0;
+        busyWorkers = (unsigned int) workers.size();
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    runRanges();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workersDone.wait(lock, [this] { return busyWorkers == 0; });
+    body = nullptr;
+}
+
+void ThreadPool::runRanges() {
+    while (true) {
+        size_t begin = nextIndex.fetch_add(grainSize);
+        if (begin >= count) {
+            return;
+        }
+        (*body)(begin, std::min(begin + grainSize, count));
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runRanges();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                workersDone.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. The thread calling parallelFor() works along with them.
+class ThreadPool {
+public:
+    // Zero workers is valid, everything then runs on the calling thread
+    explicit ThreadPool(unsigned int workerCount);
+    ~ThreadPool();
+
+    unsigned int threadCount() const { return (unsigned int) workers.size() + 1; }
+
+    // Calls body(begin, end) for consecutive ranges of at most `grainSize` elements covering [0, count),
+    // spread over all threads. Returns once every range is done.
+    void parallelFor(size_t count, size_t grainSize, std::function<void(size_t, size_t)> const &body);
+
+private:
+    // Disable copying and assignment
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator =(ThreadPool const &) = delete;
+
+    void workerLoop();
+    void runRanges();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable workersDone;
+
+    // The loop currently being run, set under the mutex
+    const std::function<void(size_t, size_t)>* body = nullptr;
+    size_t count = 0;
+    size_t grainSize = 1;
+    std::atomic<size_t> nextIndex;
+
+    unsigned int busyWorkers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
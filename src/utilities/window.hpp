@@ -15,4 +15,36 @@ const int         windowSamples   = 4;
 
 struct CommandLineOptions {
     bool enableAutoplay;
+
+    // Binary scene file to load instead of the built-in scene, and where to export the scene to
+    std::string scenePath;
+    std::string exportScenePath;
+
+    // Binary beat map to play instead of the built-in key frames, and where to export the key frames to
+    std::string beatMapPath;
+    std::string exportBeatMapPath;
+
+    // Time the ray tracer's work group layouts at startup and remember the fastest for this GPU
+    bool tuneRayTracer;
+
+    // Lower the ray tracing resolution (and bounces) as needed to hold this frame rate
+    bool         dynamicResolution;
+    unsigned int targetFps;
+
+    // GLSL image format of the ray traced color: r11f_g11f_b10f, rgba16f or rgba32f
+    std::string rayTracingFormat;
+
+    // Lights the ray tracer picks per hit when light sampling is on
+    unsigned int lightSamples;
+
+    // Parametric stress scene, filled into the box on top of the regular scene
+    unsigned int stressObjects;
+    unsigned int stressLights;
+    unsigned int stressSeed;
+
+    // Scaling benchmark, sweeps the stress scene sizes below and writes a CSV report
+    bool        runBenchmark;
+    std::string benchmarkOutput;
+    std::string benchmarkObjectCounts;  // comma separated, e.g. "0,50,100"
+    std::string benchmarkLightCounts;   // comma separated, e.g. "1,8,32"
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "workerThread.hpp"
+
+#include <utility>
+
+WorkerThread::WorkerThread() : thread(&WorkerThread::loop, this) {}
+
+WorkerThread::~WorkerThread() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobChanged.notify_all();
+    thread.join();
+}
+
+void WorkerThread::start(std::function<void()> newJob) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::move(newJob);
+        busy = true;
+    }
+    jobChanged.notify_all();
+}
+
+void WorkerThread::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobChanged.wait(lock, [this] { return !busy; });
+}
+
+void WorkerThread::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobChanged.wait(lock, [this] { return busy || stopping; });
+        if (stopping) {
+            return;
+        }
+
+        // Run without holding the lock, start() and wait() are only called around it
+        lock.unlock();
+        job();
+        lock.lock();
+
+        busy = false;
+        jobChanged.notify_all();
+    }
+}
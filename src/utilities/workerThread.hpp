@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A thread that runs one job at a time on behalf of the thread that owns it
+class WorkerThread {
+public:
+    WorkerThread();
+    ~WorkerThread();
+
+    // Hands a job to the thread, the previous one must have been waited for
+    void start(std::function<void()> job);
+
+    // Blocks until the current job (if any) is done
+    void wait();
+
+private:
+    // Disable copying and assignment
+    WorkerThread(WorkerThread const &) = delete;
+    WorkerThread & operator =(WorkerThread const &) = delete;
+
+    void loop();
+
+    std::mutex mutex;
+    std::condition_variable jobChanged;
+    std::function<void()> job;
+    bool busy = false;
+    bool stopping = false;
+
+    // Started last, once everything it uses is initialized
+    std::thread thread;
+};
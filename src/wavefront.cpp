@@ -0,0 +1,157 @@
+#include "wavefront.hpp"
+
+#include <cstddef>
+
+namespace {
+    // Layouts match raytracer.comp (std430)
+    struct QueueHeader {
+        GLuint count;
+        GLuint pad0, pad1, pad2;
+        GLuint dispatch[4];     // num_groups_x/y/z for glDispatchComputeIndirect, the last one unused
+    };
+
+    struct WavefrontRay {
+        glm::vec3 origin;     GLint pixel;
+        glm::vec3 direction;  float pad0;
+        glm::vec3 throughput; float pad1;
+    };
+
+    struct WavefrontHit {
+        GLint triangle;
+        float distance;
+        float barycentricU;
+        float barycentricV;
+    };
+
+    struct WavefrontShadowRay {
+        glm::vec3 point;  GLint pixel;
+        glm::vec3 normal; GLuint materialID;
+        glm::vec3 weight; float pad0;
+    };
+}
+
+// Two ray queues, one read and one written by every bounce
+static GLuint rayQueues[2] = {0, 0};
+static GLuint shadowQueue = 0;
+static GLuint hitBuffer = 0;
+static GLuint radianceBuffer = 0;
+
+// Every queue holds at most one entry per pixel
+static size_t pixelCapacity = 0;
+
+// Only written by the GPU, grows but never shrinks
+static void reserveQueues(size_t pixelCount) {
+    if (pixelCount <= pixelCapacity) {
+        return;
+    }
+    if (pixelCapacity == 0) {
+        glGenBuffers(2, rayQueues);
+        glGenBuffers(1, &shadowQueue);
+        glGenBuffers(1, &hitBuffer);
+        glGenBuffers(1, &radianceBuffer);
+    }
+    pixelCapacity = pixelCount;
+
+    auto allocate = [](GLuint buffer, size_t size) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    };
+    allocate(rayQueues[0], sizeof(QueueHeader) + pixelCapacity * sizeof(WavefrontRay));
+    allocate(rayQueues[1], sizeof(QueueHeader) + pixelCapacity * sizeof(WavefrontRay));
+    allocate(shadowQueue, sizeof(QueueHeader) + pixelCapacity * sizeof(WavefrontShadowRay));
+    allocate(hitBuffer, pixelCapacity * sizeof(WavefrontHit));
+    allocate(radianceBuffer, pixelCapacity * sizeof(glm::vec4));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Sets the length of a queue back to 0
+static void resetQueue(GLuint queue) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, offsetof(QueueHeader, count), sizeof(GLuint),
+                         GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// The generate and shade passes append to the queue bound as output (binding 5), the others read binding 4
+static void bindRayQueues(int output) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, rayQueues[1 - output]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, rayQueues[output]);
+}
+
+static void dispatchQueue(GLuint queue) {
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queue);
+    glDispatchComputeIndirect(offsetof(QueueHeader, dispatch));
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+void traceWavefront(std::function<Gloom::Shader*(WavefrontStage)> const &stageProgram, RayTracerLayout const &layout,
+                    int triangleCount, glm::ivec2 traceSize, int firstBounce, int maxBounces)
+{
+    reserveQueues(size_t(traceSize.x) * size_t(traceSize.y));
+
+    auto activate = [&](WavefrontStage stage) {
+        Gloom::Shader* program = stageProgram(stage);
+        program->activate();
+        glUniform1i(program->getUniformFromName("numTriangles"), triangleCount);
+        glUniform2i(program->getUniformFromName("traceSize"), traceSize.x, traceSize.y);
+        return program;
+    };
+    GLuint pixelGroupsX = (traceSize.x + layout.localSizeX - 1) / layout.localSizeX;
+    GLuint pixelGroupsY = (traceSize.y + layout.localSizeY - 1) / layout.localSizeY;
+
+    // Sizes the next intersection pass from the input ray queue, then shades the queued hits
+    auto traceShadowRays = [&]() {
+        activate(WAVEFRONT_PREPARE);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+        activate(WAVEFRONT_SHADOW);
+        dispatchQueue(shadowQueue);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        resetQueue(shadowQueue);
+    };
+
+    // Last frame's passes may still be writing the queue lengths
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    resetQueue(rayQueues[0]);
+    resetQueue(rayQueues[1]);
+    resetQueue(shadowQueue);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, hitBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, shadowQueue);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, radianceBuffer);
+
+    int output = 0;
+    bindRayQueues(output);
+    activate(WAVEFRONT_GENERATE);
+    glDispatchCompute(pixelGroupsX, pixelGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // What the generate pass queued is the input of the first bounce
+    output = 1 - output;
+    bindRayQueues(output);
+    traceShadowRays();
+
+    for (int bounce = firstBounce; bounce < maxBounces; bounce++) {
+        GLuint input = rayQueues[1 - output];
+
+        activate(WAVEFRONT_INTERSECT);
+        dispatchQueue(input);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        Gloom::Shader* shade = activate(WAVEFRONT_SHADE);
+        glUniform1i(shade->getUniformFromName("bounce"), bounce);
+        dispatchQueue(input);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // The reflected rays are the next bounce's input, and the rays just traced make room for its output
+        resetQueue(input);
+        output = 1 - output;
+        bindRayQueues(output);
+        traceShadowRays();
+    }
+
+    activate(WAVEFRONT_RESOLVE);
+    glDispatchCompute(pixelGroupsX, pixelGroupsY, 1);
+    glUseProgram(0);
+}
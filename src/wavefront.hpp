@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <utilities/shader.hpp>
+#include "rayTracerTuning.hpp"
+
+// Wavefront ray tracing. Instead of one thread following its path through every bounce while its neighbours have
+// long finished, every bounce runs as separate intersection, shading and shadow ray passes over queues of the rays
+// that are still alive. The queues live in storage buffers and are sized on the GPU, through indirect dispatches,
+// so nothing is read back.
+
+// The passes, their values match WAVEFRONT_STAGE in raytracer.comp
+enum WavefrontStage {
+    WAVEFRONT_GENERATE = 1,  // reprojects or queues a primary ray per pixel
+    WAVEFRONT_PREPARE,       // turns the queue lengths into indirect dispatch sizes
+    WAVEFRONT_INTERSECT,     // finds the closest hit of every queued ray
+    WAVEFRONT_SHADE,         // queues the shading of every hit and its reflected ray
+    WAVEFRONT_SHADOW,        // shades the queued hits, tracing their shadow rays
+    WAVEFRONT_RESOLVE        // writes the gathered color into the output image
+};
+
+// Threads per work group of the passes that run over a queue
+const int wavefrontGroupSize = 64;
+
+// Traces the bottom left `traceSize` part of the output image with the inputs bound by uploadRayTracerInputs().
+// `stageProgram` returns the program of each pass; the pixel passes are laid out as `layout`. With `firstBounce`
+// set to 1 the generate pass has already queued the shading of the rasterized primary hits.
+void traceWavefront(std::function<Gloom::Shader*(WavefrontStage)> const &stageProgram, RayTracerLayout const &layout,
+                    int triangleCount, glm::ivec2 traceSize, int firstBounce, int maxBounces);